@@ -0,0 +1,175 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <glad/glad.h>
+
+// Where a raymarching shader spends its time: with the shader built with COST_HEATMAP (see the prelude in
+// ShaderSource.h) every visible pixel adds its map() calls and loop iterations to a histogram in a shader storage
+// buffer. The buffer is cleared before the eyes and copied after them into the next buffer of a small ring, which is
+// read once its fence has signaled a few frames later, like ReadbackRing. Nothing waits on the GPU, when the whole ring
+// is in flight the frame isn't counted. Counts add up until report(), average, 99th percentile and maximum per pixel.
+enum class CostView { Off, MapCalls, Iterations };
+
+struct CostStats {
+	double average = 0.0;
+	unsigned p99 = 0; // upper end of the histogram bin
+	unsigned max = 0;
+};
+
+struct CostHeatmap {
+	static const int binCount = 256; // COST_BINS in the prelude
+	static const int ringSize = 3;
+	static const GLuint binding = 0;
+	// std430 layout of CostHistogram
+	struct Histogram {
+		uint32_t pixels;
+		uint32_t max[2];
+		uint32_t sum[4];
+		uint32_t bins[2 * binCount];
+	};
+	struct Slot {
+		GLuint bufferId = 0;
+		GLsync fence = nullptr;
+	};
+	CostView view = CostView::Off;
+	float binWidth = 4.0f; // counts per bin, the last one takes everything beyond
+	GLuint bufferId = 0;
+	Slot ring[ringSize];
+	int next = 0;
+	int pending = 0;
+	long long dropped = 0;
+
+	// since the last report
+	long long frames = 0;
+	uint64_t pixels = 0;
+	uint64_t sum[2] = {};
+	uint32_t max[2] = {};
+	uint64_t counts[2][binCount] = {};
+	CostStats shown[2]; // of those, for the status line and the color scale
+
+	CostHeatmap() {
+		glCreateBuffers(1, &bufferId);
+		glNamedBufferStorage(bufferId, sizeof(Histogram), nullptr, GL_DYNAMIC_STORAGE_BIT);
+		for (Slot& s : ring) {
+			glCreateBuffers(1, &s.bufferId);
+			glNamedBufferStorage(s.bufferId, sizeof(Histogram), nullptr, GL_MAP_READ_BIT | GL_CLIENT_STORAGE_BIT);
+		}
+	}
+
+	~CostHeatmap() {
+		for (Slot& s : ring) {
+			if (s.fence) { glDeleteSync(s.fence); }
+			glDeleteBuffers(1, &s.bufferId);
+		}
+		glDeleteBuffers(1, &bufferId);
+	}
+
+	bool active() const { return view != CostView::Off; }
+
+	const char* name() const {
+		switch (view) {
+		case CostView::MapCalls: return "map calls";
+		case CostView::Iterations: return "loop iterations";
+		default: return "off";
+		}
+	}
+
+	void cycleView() {
+		view = view == CostView::Off ? CostView::MapCalls : view == CostView::MapCalls ? CostView::Iterations : CostView::Off;
+	}
+
+	// The viewed counter, scaled so that its 99th percentile so far is red
+	void setUniforms(GLuint program) const {
+		const int counter = view == CostView::Iterations ? 1 : 0;
+		glProgramUniform1i(program, glGetUniformLocation(program, "costView"), counter);
+		glProgramUniform1f(program, glGetUniformLocation(program, "costRange"), (float)std::max(16u, shown[counter].p99));
+		glProgramUniform1f(program, glGetUniformLocation(program, "costBinWidth"), binWidth);
+	}
+
+	// Before the eyes
+	void beginFrame() {
+		if (!active()) { return; }
+		collect(false);
+		glClearNamedBufferData(bufferId, GL_R32UI, GL_RED_INTEGER, GL_UNSIGNED_INT, nullptr);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, bufferId);
+	}
+
+	// After the eyes
+	void endFrame() {
+		if (!active()) { return; }
+		if (pending == ringSize) { dropped++; return; }
+		Slot& s = ring[next];
+		glMemoryBarrier(GL_BUFFER_UPDATE_BARRIER_BIT);
+		glCopyNamedBufferSubData(bufferId, s.bufferId, 0, 0, sizeof(Histogram));
+		s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		next = (next + 1) % ringSize;
+		pending++;
+	}
+
+	CostStats stats(int counter) const {
+		CostStats s;
+		if (pixels == 0) { return s; }
+		s.average = (double)sum[counter] / pixels;
+		s.max = max[counter];
+		uint64_t below = 0;
+		for (int i = 0; i < binCount; i++) {
+			below += counts[counter][i];
+			if (below * 100 >= pixels * 99) { s.p99 = std::min(s.max, (unsigned)((i + 1) * binWidth)); break; }
+		}
+		return s;
+	}
+
+	// Recomputes the shown stats, cheap enough for every frame
+	void update() {
+		if (pixels == 0) { return; }
+		shown[0] = stats(0);
+		shown[1] = stats(1);
+	}
+
+	// Prints the counts since the last report for the shader, they start over
+	void report(const std::string& shader) {
+		collect(true);
+		if (pixels > 0) {
+			update();
+			std::cout << std::endl << "Cost of " << shader << " over " << frames << " frames, " << pixels << " pixels, per pixel:" << std::endl;
+			for (int counter = 0; counter < 2; counter++) {
+				std::cout << std::fixed << std::setprecision(1) << "  " << (counter == 0 ? "map calls      " : "loop iterations")
+					<< " average " << shown[counter].average << ", p99 " << shown[counter].p99 << ", max " << shown[counter].max << std::endl;
+			}
+			if (dropped > 0) { std::cout << "  " << dropped << " frames not counted, readbacks in flight" << std::endl; }
+		}
+		frames = 0;
+		pixels = 0;
+		dropped = 0;
+		memset(sum, 0, sizeof(sum));
+		memset(max, 0, sizeof(max));
+		memset(counts, 0, sizeof(counts));
+	}
+
+private:
+	void collect(bool wait) {
+		while (pending > 0) {
+			Slot& s = ring[(next - pending + ringSize) % ringSize];
+			GLenum status = glClientWaitSync(s.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? GL_TIMEOUT_IGNORED : 0);
+			if (status == GL_TIMEOUT_EXPIRED) { return; }
+			glDeleteSync(s.fence);
+			s.fence = nullptr;
+			pending--;
+			const Histogram* h = (const Histogram*)glMapNamedBufferRange(s.bufferId, 0, sizeof(Histogram), GL_MAP_READ_BIT);
+			if (!h) { continue; }
+			frames++;
+			pixels += h->pixels;
+			for (int counter = 0; counter < 2; counter++) {
+				sum[counter] += h->sum[counter * 2] | (uint64_t)h->sum[counter * 2 + 1] << 32;
+				max[counter] = std::max(max[counter], h->max[counter]);
+				for (int i = 0; i < binCount; i++) { counts[counter][i] += h->bins[counter * binCount + i]; }
+			}
+			glUnmapNamedBuffer(s.bufferId);
+		}
+	}
+};
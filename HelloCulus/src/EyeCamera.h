@@ -0,0 +1,21 @@
+#pragma once
+#include <OVR_CAPI.h>
+#include <Extras/OVR_Math.h>
+
+// World space camera of one eye for one frame. The ray through eye buffer texture coordinate (u, v) in [0, 1]
+// is rayCorner() + u * rayRight() + v * rayUp(), which is what the shader prelude's rayDirection() evaluates.
+struct EyeCamera {
+	OVR::Vector3f position;
+	OVR::Vector3f side;
+	OVR::Vector3f up;
+	OVR::Vector3f forward;
+	ovrFovPort fov;
+
+	OVR::Vector3f rayCorner() const { return forward - side * fov.LeftTan - up * fov.DownTan; }
+	OVR::Vector3f rayRight() const { return side * (fov.LeftTan + fov.RightTan); }
+	OVR::Vector3f rayUp() const { return up * (fov.UpTan + fov.DownTan); }
+
+	// Tangent space extents of the eye buffer, (0, 0) being the view axis
+	OVR::Vector2f tanMin() const { return OVR::Vector2f(-fov.LeftTan, -fov.DownTan); }
+	OVR::Vector2f tanSize() const { return OVR::Vector2f(fov.LeftTan + fov.RightTan, fov.DownTan + fov.UpTan); }
+};
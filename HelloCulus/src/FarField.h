@@ -0,0 +1,128 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <string>
+
+#include <glad/glad.h>
+
+#include <OVR_CAPI.h>
+#include <Extras/OVR_Math.h>
+
+#include "EyeCamera.h"
+#include "GlDebug.h"
+#include "GlState.h"
+#include "ShaderSource.h"
+
+// Mono far field for shaders that declare "// @farfield <stereo distance>". Beyond a few meters the disparity between
+// the eyes is below a pixel, so content past the stereo distance is marched once per frame from the midpoint between
+// the eyes, over the union of both eyes' FOVs. Each eye then marches only the near field, built with NEAR_FIELD,
+// and takes what it doesn't hit from the shared buffer with farFieldColor().
+// Shaders limit their march to marchRange: [stereo distance, inf) for the far field, [0, stereo distance] for each eye.
+struct MonoFarField {
+	float stereoDistance = 10.0f;
+	ovrFovPort fov; // union of both eyes
+	OVR::Sizei size;
+	GLuint fboId = 0;
+	GLuint colorTexId = 0;
+	GLuint farProg = 0;
+	GLuint nearProg = 0;
+	EyeCamera camera; // of the far field rendered this frame
+
+	MonoFarField(const ovrFovPort eyeFov[2], const OVR::Sizei eyeSize[2]) {
+		fov.LeftTan = std::max(eyeFov[0].LeftTan, eyeFov[1].LeftTan);
+		fov.RightTan = std::max(eyeFov[0].RightTan, eyeFov[1].RightTan);
+		fov.UpTan = std::max(eyeFov[0].UpTan, eyeFov[1].UpTan);
+		fov.DownTan = std::max(eyeFov[0].DownTan, eyeFov[1].DownTan);
+		// same pixel density as the eye buffers
+		float density = eyeSize[0].w / (eyeFov[0].LeftTan + eyeFov[0].RightTan);
+		size = OVR::Sizei((int)std::ceil(density * (fov.LeftTan + fov.RightTan)), (int)std::ceil(density * (fov.UpTan + fov.DownTan)));
+
+		glGenTextures(1, &colorTexId);
+		glBindTexture(GL_TEXTURE_2D, colorTexId);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, size.w, size.h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glGenFramebuffers(1, &fboId);
+		glState().bindFramebuffer(fboId);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexId, 0);
+		glState().bindFramebuffer(0);
+	}
+
+	~MonoFarField() {
+		unload();
+		glDeleteFramebuffers(1, &fboId);
+		glDeleteTextures(1, &colorTexId);
+	}
+
+	bool active() const { return nearProg != 0; }
+
+	void unload() {
+		glDeleteProgram(farProg);
+		glDeleteProgram(nearProg);
+		farProg = nearProg = 0;
+	}
+
+	// Builds the far and near field programs if the shader declares a stereo distance. Returns whether it is active.
+	bool load(const ShaderSource& source, const ShaderDefines& defines) {
+		unload();
+		const ShaderDirective* d = source.findDirective("farfield");
+		if (!d) { return false; }
+		// a malformed distance keeps the current one
+		float distance = 0.0f;
+		if (d->number(0, distance)) {
+			if (distance > 0.0f) { stereoDistance = distance; }
+			else { std::cout << "@farfield: stereo distance " << distance << " is not positive, ignored" << std::endl; }
+		}
+		ShaderDefines farDefines = defines;
+		farDefines.push_back({ "FAR_FIELD", "1" });
+		ShaderDefines nearDefines = defines;
+		nearDefines.push_back({ "NEAR_FIELD", "1" });
+		farProg = linkFragmentProgram(source.build(farDefines));
+		nearProg = linkFragmentProgram(source.build(nearDefines));
+		if (!farProg || !nearProg) {
+			std::cout << "Mono far field disabled, one of its programs failed to build." << std::endl;
+			unload();
+			return false;
+		}
+		std::cout << "Mono far field beyond " << stereoDistance << " m, " << size.w << "x" << size.h << " shared buffer" << std::endl;
+		return true;
+	}
+
+	// Camera between the eyes: midpoint position, head orientation and the union FOV.
+	EyeCamera centerCamera(const OVR::Vector3f& position, const OVR::Matrix4f& rotation) const {
+		return { position, rotation.Transform(OVR::Vector3f(1, 0, 0)), rotation.Transform(OVR::Vector3f(0, 1, 0)), rotation.Transform(OVR::Vector3f(0, 0, -1)), fov };
+	}
+
+	// Marches everything beyond the stereo distance from the center camera. setUniforms sets the frame's uniforms of
+	// the far program, drawScene renders the bound target at the given size.
+	void render(const EyeCamera& center,
+		const std::function<void(GLuint)>& setUniforms,
+		const std::function<void(GLuint, OVR::Sizei)>& drawScene) {
+		GlDebugGroup group("far field");
+		camera = center;
+		glState().bindFramebuffer(fboId);
+		glState().viewport(0, 0, size.w, size.h);
+		glState().enable(GL_FRAMEBUFFER_SRGB);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		glState().useProgram(farProg);
+		setUniforms(farProg);
+		glProgramUniform2f(farProg, glGetUniformLocation(farProg, "marchRange"), stereoDistance, 1e9f);
+		drawScene(farProg, size);
+	}
+
+	// Near field range and the shared buffer for the eyes, before they draw with nearProg.
+	void bindNear() {
+		glProgramUniform2f(nearProg, glGetUniformLocation(nearProg, "marchRange"), 0.0f, stereoDistance);
+		glProgramUniform3f(nearProg, glGetUniformLocation(nearProg, "farSide"), camera.side.x, camera.side.y, camera.side.z);
+		glProgramUniform3f(nearProg, glGetUniformLocation(nearProg, "farUp"), camera.up.x, camera.up.y, camera.up.z);
+		glProgramUniform3f(nearProg, glGetUniformLocation(nearProg, "farForward"), camera.forward.x, camera.forward.y, camera.forward.z);
+		glProgramUniform2f(nearProg, glGetUniformLocation(nearProg, "farTanMin"), camera.tanMin().x, camera.tanMin().y);
+		glProgramUniform2f(nearProg, glGetUniformLocation(nearProg, "farTanSize"), camera.tanSize().x, camera.tanSize().y);
+		glProgramUniform1i(nearProg, glGetUniformLocation(nearProg, "farField"), 0);
+		glState().bindTexture(0, colorTexId);
+	}
+};
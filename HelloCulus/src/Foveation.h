@@ -0,0 +1,275 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <OVR_CAPI.h>
+#include <Extras/OVR_Math.h>
+
+#include "FullscreenTriangle.h"
+#include "GlDebug.h"
+#include "GlState.h"
+#include "HiddenAreaMask.h"
+#include "ShaderSource.h"
+
+// Fixed foveated rendering. The eye is split into rings around the lens center (the projection center of the
+// asymmetric FOV). Radii are in tangent units, i.e. 1.0 is 45 degrees off the view axis.
+// The innermost ring is raymarched at full rate into the eye buffer, outer rings are raymarched into smaller
+// offscreen targets and upsampled into the eye buffer before it is committed.
+// Shaders can choose their own rings with "// @foveation radius:scale radius:scale ...".
+struct FoveationRing {
+	float radius; // outer radius, the last ring extends to the corners
+	float scale;  // resolution scale, 1.0 for the center
+};
+
+struct FoveationConfig {
+	std::vector<FoveationRing> rings;
+
+	static FoveationConfig defaults() {
+		FoveationConfig config;
+		config.rings = { { 0.6f, 1.0f }, { 1.0f, 0.5f }, { 10.0f, 0.33f } };
+		return config;
+	}
+
+	// A malformed ring keeps the previous rings, the shader may be in the middle of an edit
+	static FoveationConfig fromShader(const ShaderSource& source, const FoveationConfig& previous) {
+		const ShaderDirective* d = source.findDirective("foveation");
+		if (!d) { return defaults(); }
+		FoveationConfig config;
+		for (const std::string& arg : d->args) {
+			size_t colon = arg.find(':');
+			if (colon == std::string::npos) { continue; }
+			FoveationRing ring = {};
+			if (!ShaderDirective::parseNumber(arg.substr(0, colon), ring.radius) || !ShaderDirective::parseNumber(arg.substr(colon + 1), ring.scale)
+				|| ring.radius <= 0.0f || ring.scale <= 0.0f) {
+				std::cout << "@foveation: " << arg << " is not radius:scale with positive numbers, keeping the previous rings" << std::endl;
+				return previous;
+			}
+			config.rings.push_back(ring);
+		}
+		std::sort(config.rings.begin(), config.rings.end(), [](const FoveationRing& a, const FoveationRing& b) { return a.radius < b.radius; });
+		if (config.rings.empty()) { return defaults(); }
+		config.rings[0].scale = 1.0f;
+		config.rings.back().radius = 10.0f;
+		return config;
+	}
+};
+
+// Offscreen color + depth target of one reduced-rate ring.
+struct FoveationTarget {
+	GLuint fboId = 0;
+	GLuint colorTexId = 0;
+	GLuint depthRbId = 0;
+	OVR::Sizei size;
+	bool primed = false;
+
+	void create(OVR::Sizei targetSize) {
+		size = targetSize;
+		glGenTextures(1, &colorTexId);
+		glBindTexture(GL_TEXTURE_2D, colorTexId);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, size.w, size.h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glGenRenderbuffers(1, &depthRbId);
+		glBindRenderbuffer(GL_RENDERBUFFER, depthRbId);
+		glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, size.w, size.h);
+		glGenFramebuffers(1, &fboId);
+		glState().bindFramebuffer(fboId);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexId, 0);
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthRbId);
+		glState().bindFramebuffer(0);
+	}
+
+	void destroy() {
+		glDeleteFramebuffers(1, &fboId);
+		glDeleteRenderbuffers(1, &depthRbId);
+		glDeleteTextures(1, &colorTexId);
+		fboId = colorTexId = depthRbId = 0;
+	}
+};
+
+struct FoveatedRenderer {
+	static const int maxRings = 4; // center + 3 reduced-rate rings
+	FoveationConfig config;
+	ovrFovPort fov[2];
+	OVR::Sizei eyeSize[2];
+	std::vector<FoveationTarget> targets[2]; // one per ring after the center
+	GLuint maskProg;
+	GLuint compositeProg;
+
+	FoveatedRenderer(const ovrFovPort eyeFov[2], const OVR::Sizei eyeBufferSize[2]) {
+		for (int eye = 0; eye < 2; eye++) {
+			fov[eye] = eyeFov[eye];
+			eyeSize[eye] = eyeBufferSize[eye];
+		}
+		// Writes near plane depth (or the given one) outside [innerRadius, outerRadius), so only the ring gets raymarched.
+		maskProg = linkFragmentProgram(R"GLSL(
+#version 410
+uniform vec2 viewport;
+uniform vec2 tanMin;
+uniform vec2 tanSize;
+uniform float innerRadius;
+uniform float outerRadius;
+uniform float depth = 0.0;
+void main() {
+    float r = length(tanMin + gl_FragCoord.xy / viewport * tanSize);
+    if (r >= innerRadius && r < outerRadius) discard;
+    gl_FragDepth = depth;
+}
+)GLSL");
+		// Fills everything outside the center from the reduced-rate rings with bilinear upsampling.
+		compositeProg = linkFragmentProgram(R"GLSL(
+#version 410
+out vec4 fragColor;
+uniform vec2 viewport;
+uniform vec2 tanMin;
+uniform vec2 tanSize;
+uniform float centerRadius;
+uniform float ringRadius[3];
+uniform int ringCount;
+uniform sampler2D ring0;
+uniform sampler2D ring1;
+uniform sampler2D ring2;
+void main() {
+    vec2 uv = gl_FragCoord.xy / viewport;
+    float r = length(tanMin + uv * tanSize);
+    if (r < centerRadius) discard;
+    if (ringCount < 2 || r < ringRadius[0]) fragColor = texture(ring0, uv);
+    else if (ringCount < 3 || r < ringRadius[1]) fragColor = texture(ring1, uv);
+    else fragColor = texture(ring2, uv);
+}
+)GLSL");
+		configure(FoveationConfig::defaults());
+	}
+
+	~FoveatedRenderer() {
+		for (int eye = 0; eye < 2; eye++) {
+			for (FoveationTarget& target : targets[eye]) { target.destroy(); }
+		}
+		glDeleteProgram(maskProg);
+		glDeleteProgram(compositeProg);
+	}
+
+	void configure(const FoveationConfig& newConfig) {
+		config = newConfig;
+		if ((int)config.rings.size() > maxRings) { config.rings.resize(maxRings); config.rings.back().radius = 10.0f; }
+		for (int eye = 0; eye < 2; eye++) {
+			for (FoveationTarget& target : targets[eye]) { target.destroy(); }
+			targets[eye].clear();
+			for (size_t i = 1; i < config.rings.size(); i++) {
+				FoveationTarget target;
+				float scale = config.rings[i].scale;
+				target.create(OVR::Sizei((int)std::ceil(eyeSize[eye].w * scale), (int)std::ceil(eyeSize[eye].h * scale)));
+				targets[eye].push_back(target);
+			}
+		}
+		std::cout << "Foveation rings:";
+		for (const FoveationRing& ring : config.rings) { std::cout << " " << ring.radius << ":" << ring.scale; }
+		std::cout << ", shading " << shadedFraction() * 100.0 << "% of full rate pixels" << std::endl;
+	}
+
+	// Ring masks depend on the hidden area too, so they get re-primed when that is toggled.
+	void invalidate() {
+		for (int eye = 0; eye < 2; eye++) {
+			for (FoveationTarget& target : targets[eye]) { target.primed = false; }
+		}
+	}
+
+	OVR::Vector2f tanMin(int eye) const { return OVR::Vector2f(-fov[eye].LeftTan, -fov[eye].DownTan); }
+	OVR::Vector2f tanSize(int eye) const { return OVR::Vector2f(fov[eye].LeftTan + fov[eye].RightTan, fov[eye].DownTan + fov[eye].UpTan); }
+
+	float innerRadius(size_t ring) const { return ring == 0 ? 0.0f : config.rings[ring - 1].radius; }
+
+	// Expected cost relative to shading every eye pixel at full rate, from ring areas sampled over the left eye.
+	double shadedFraction() const {
+		const int samples = 256;
+		double total = 0.0;
+		for (int y = 0; y < samples; y++) {
+			for (int x = 0; x < samples; x++) {
+				OVR::Vector2f t = tanMin(0) + OVR::Vector2f(tanSize(0).x * (x + 0.5f) / samples, tanSize(0).y * (y + 0.5f) / samples);
+				float r = t.Length();
+				size_t ring = 0;
+				while (ring + 1 < config.rings.size() && r >= config.rings[ring].radius) { ring++; }
+				total += config.rings[ring].scale * config.rings[ring].scale;
+			}
+		}
+		return total / (samples * samples);
+	}
+
+	// Near plane depth outside the ring, drawn into the bound target.
+	void primeRing(int eye, size_t ring, OVR::Sizei size, float margin, float depth = 0.0f) {
+		glState().useProgram(maskProg);
+		glProgramUniform2f(maskProg, glGetUniformLocation(maskProg, "viewport"), (float)size.w, (float)size.h);
+		glProgramUniform2f(maskProg, glGetUniformLocation(maskProg, "tanMin"), tanMin(eye).x, tanMin(eye).y);
+		glProgramUniform2f(maskProg, glGetUniformLocation(maskProg, "tanSize"), tanSize(eye).x, tanSize(eye).y);
+		glProgramUniform1f(maskProg, glGetUniformLocation(maskProg, "innerRadius"), innerRadius(ring) - margin);
+		glProgramUniform1f(maskProg, glGetUniformLocation(maskProg, "outerRadius"), config.rings[ring].radius + margin);
+		glProgramUniform1f(maskProg, glGetUniformLocation(maskProg, "depth"), depth);
+		glState().colorMask(GL_FALSE);
+		glState().enable(GL_DEPTH_TEST);
+		glState().depthFunc(GL_ALWAYS);
+		glState().depthMask(GL_TRUE);
+		fullscreen().draw(maskProg);
+		glState().colorMask(GL_TRUE);
+		glState().depthFunc(GL_LESS);
+		glState().disable(GL_DEPTH_TEST);
+	}
+
+	// Raymarches every reduced-rate ring of the eye into its target. drawScene renders the bound target at the given size.
+	void renderPeriphery(int eye, const HiddenAreaMask* hiddenArea, const std::function<void(OVR::Sizei)>& drawScene) {
+		GlDebugGroup group("foveation periphery");
+		for (size_t i = 0; i < targets[eye].size(); i++) {
+			FoveationTarget& target = targets[eye][i];
+			glState().bindFramebuffer(target.fboId);
+			glState().viewport(0, 0, target.size.w, target.size.h);
+			glState().enable(GL_FRAMEBUFFER_SRGB);
+			if (!target.primed) {
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				if (hiddenArea) { hiddenArea->primeDepth(); }
+				// a couple of texels around the ring so bilinear upsampling at its edges has valid neighbors
+				primeRing(eye, i + 1, target.size, 2.0f * tanSize(eye).x / target.size.w);
+				target.primed = true;
+			}
+			drawScene(target.size);
+		}
+	}
+
+	// Near plane depth outside the center, into the bound eye buffer.
+	void primeCenter(int eye) {
+		GlDebugGroup group("foveation center depth");
+		primeRing(eye, 0, eyeSize[eye], 0.0f);
+	}
+
+	// Far plane depth outside the center of the bound eye buffer after compositing, in place of primeCenter's near plane
+	// depth. The rings carry no ray depth, this way the compositor reprojects them for rotation only.
+	void farPeriphery(int eye) {
+		GlDebugGroup group("foveation far depth");
+		primeRing(eye, 0, eyeSize[eye], 0.0f, 1.0f);
+	}
+
+	// Upsamples the rings into the bound eye buffer around the already rendered center.
+	void composite(int eye) {
+		GlDebugGroup group("foveation composite");
+		glState().useProgram(compositeProg);
+		glProgramUniform2f(compositeProg, glGetUniformLocation(compositeProg, "viewport"), (float)eyeSize[eye].w, (float)eyeSize[eye].h);
+		glProgramUniform2f(compositeProg, glGetUniformLocation(compositeProg, "tanMin"), tanMin(eye).x, tanMin(eye).y);
+		glProgramUniform2f(compositeProg, glGetUniformLocation(compositeProg, "tanSize"), tanSize(eye).x, tanSize(eye).y);
+		glProgramUniform1f(compositeProg, glGetUniformLocation(compositeProg, "centerRadius"), config.rings[0].radius);
+		glProgramUniform1i(compositeProg, glGetUniformLocation(compositeProg, "ringCount"), (int)targets[eye].size());
+		const char* samplers[3] = { "ring0", "ring1", "ring2" };
+		for (size_t i = 0; i < targets[eye].size(); i++) {
+			glState().bindTexture((int)i, targets[eye][i].colorTexId);
+			glProgramUniform1i(compositeProg, glGetUniformLocation(compositeProg, samplers[i]), (GLint)i);
+			std::string radius = "ringRadius[" + std::to_string(i) + "]";
+			glProgramUniform1f(compositeProg, glGetUniformLocation(compositeProg, radius.c_str()), config.rings[i + 1].radius);
+		}
+		fullscreen().draw(compositeProg);
+	}
+};
@@ -0,0 +1,149 @@
+#pragma once
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <Extras/OVR_Math.h>
+
+#include "Profiler.h"
+#include "ReadbackRing.h"
+
+// Records a framebuffer (the mirror texture) to a Y4M video without stalling the frame loop. Frames are read back
+// through a ReadbackRing and go to a writer thread that converts them to YUV 4:2:0 and writes them. When the GPU is so
+// far behind that the whole ring is in flight, or the disk so slow that the writer's queue is full, the frame is
+// dropped and counted.
+struct FrameCapture {
+	static const size_t maxQueued = 8; // frames waiting for the writer
+	OVR::Sizei size;
+	ReadbackRing readback;
+	std::string path;
+	bool recording = false;
+	long long droppedWriter = 0; // writer behind
+
+	std::thread writer;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::deque<std::vector<unsigned char>> queue;
+	std::vector<std::vector<unsigned char>> freeBuffers; // reused, no allocation per frame
+	bool stopping = false;
+	long long written = 0;
+
+	explicit FrameCapture(OVR::Sizei size) :
+		size(size),
+		readback(size) {
+	}
+
+	~FrameCapture() {
+		stop();
+	}
+
+	long long captured() const { return readback.started; }
+	long long dropped() const { return readback.dropped + droppedWriter; }
+
+	// Opens the file and starts the writer. fps goes into the header, dropped frames make the video run faster.
+	bool start(const std::string& filepath, int fps) {
+		if (recording) { return true; }
+		std::ofstream file(filepath, std::ios::binary);
+		if (!file) { std::cout << "Can't write " << filepath << std::endl; return false; }
+		file << "YUV4MPEG2 W" << size.w << " H" << size.h << " F" << fps << ":1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n";
+		path = filepath;
+		readback.started = readback.dropped = droppedWriter = written = 0;
+		stopping = false;
+		recording = true;
+		writer = std::thread([this](std::ofstream out) { write(out); }, std::move(file));
+		std::cout << "Capturing " << size.w << "x" << size.h << " to " << path << std::endl;
+		return true;
+	}
+
+	// Waits for the frames in flight and the writer, then prints the counters.
+	void stop() {
+		if (!recording) { return; }
+		readback.collect([this](const unsigned char* pixels) { enqueue(pixels); }, true);
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		wake.notify_one();
+		writer.join();
+		recording = false;
+		std::cout << std::endl << "Captured " << written << " frames to " << path << ", dropped " << readback.dropped
+			<< " with all " << ReadbackRing::ringSize << " readbacks in flight and " << droppedWriter << " with the writer behind" << std::endl;
+	}
+
+	// After the frame was submitted. Collects finished readbacks and starts one of framebuffer fboId.
+	void capture(GLuint fboId) {
+		if (!recording) { return; }
+		readback.collect([this](const unsigned char* pixels) { enqueue(pixels); });
+		readback.read(fboId);
+	}
+
+private:
+	void enqueue(const unsigned char* mapped) {
+		std::vector<unsigned char> pixels;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (queue.size() >= maxQueued) { droppedWriter++; return; }
+			if (!freeBuffers.empty()) { pixels.swap(freeBuffers.back()); freeBuffers.pop_back(); }
+		}
+		pixels.assign(mapped, mapped + readback.frameBytes());
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			queue.push_back(std::move(pixels));
+		}
+		wake.notify_one();
+	}
+
+	// Writer thread: RGBA rows to full range BT.601 YUV 4:2:0. The mirror texture's first row is the top one.
+	void write(std::ofstream& out) {
+		const int w = size.w, h = size.h, cw = (w + 1) / 2, ch = (h + 1) / 2;
+		std::vector<unsigned char> yuv((size_t)w * h + 2 * (size_t)cw * ch);
+		profiler().nameThread("capture writer");
+		for (;;) {
+			std::vector<unsigned char> pixels;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this] { return stopping || !queue.empty(); });
+				if (queue.empty()) { break; }
+				pixels.swap(queue.front());
+				queue.pop_front();
+			}
+			ProfileZone zone("encode frame");
+			unsigned char* yPlane = yuv.data();
+			unsigned char* uPlane = yPlane + (size_t)w * h;
+			unsigned char* vPlane = uPlane + (size_t)cw * ch;
+			for (int y = 0; y < h; y++) {
+				for (int x = 0; x < w; x++) {
+					const unsigned char* p = &pixels[((size_t)y * w + x) * 4];
+					yPlane[(size_t)y * w + x] = (unsigned char)((77 * p[0] + 150 * p[1] + 29 * p[2] + 128) >> 8);
+				}
+			}
+			for (int y = 0; y < ch; y++) {
+				for (int x = 0; x < cw; x++) {
+					// average of the 2x2 block, clamped at odd edges
+					int r = 0, g = 0, b = 0;
+					for (int dy = 0; dy < 2; dy++) {
+						for (int dx = 0; dx < 2; dx++) {
+							const unsigned char* p = &pixels[((size_t)std::min(2 * y + dy, h - 1) * w + std::min(2 * x + dx, w - 1)) * 4];
+							r += p[0]; g += p[1]; b += p[2];
+						}
+					}
+					uPlane[(size_t)y * cw + x] = (unsigned char)std::min(255, std::max(0, (-43 * r - 85 * g + 128 * b + 512) / 1024 + 128));
+					vPlane[(size_t)y * cw + x] = (unsigned char)std::min(255, std::max(0, (128 * r - 107 * g - 21 * b + 512) / 1024 + 128));
+				}
+			}
+			out << "FRAME\n";
+			out.write((const char*)yuv.data(), yuv.size());
+			std::lock_guard<std::mutex> lock(mutex);
+			freeBuffers.push_back(std::move(pixels));
+			written++;
+		}
+	}
+};
@@ -0,0 +1,59 @@
+#pragma once
+#include <iostream>
+
+#include <OVR_CAPI.h>
+
+// Frame rate divisor for shaders that can't hold the display rate. At half rate every rendered frame is shown for two
+// display intervals and the compositor reprojects it (positionally, when the shader writes ray depth). Poses are
+// predicted for the middle of the intervals a frame is shown for, and frameIndex advances by the divisor so the
+// runtime paces submissions instead of dropping random frames.
+enum class FrameRateMode { Auto, Full, Half };
+
+struct FrameRateControl {
+	FrameRateMode mode = FrameRateMode::Auto;
+	int divisor = 1;
+	double refreshRate = 90.0;
+	double headroom = 0.85; // share of a display interval the eyes may use, the rest goes to the compositor
+	int switchFrames = 45;  // consecutive frames over (or well under) budget before auto mode switches
+	int overBudgetFrames = 0;
+	int underBudgetFrames = 0;
+
+	double budgetMs() const { return 1000.0 / refreshRate * headroom; }
+
+	// Display time to predict poses for: halfway through the intervals the frame stays on screen.
+	double predictedDisplayTime(ovrSession session, long long frameIndex) const {
+		return ovr_GetPredictedDisplayTime(session, frameIndex) + 0.5 * (divisor - 1) / refreshRate;
+	}
+
+	const char* name() const {
+		switch (mode) {
+		case FrameRateMode::Full: return "full";
+		case FrameRateMode::Half: return "half";
+		default: return "auto";
+		}
+	}
+
+	void cycleMode() {
+		mode = mode == FrameRateMode::Auto ? FrameRateMode::Full : (mode == FrameRateMode::Full ? FrameRateMode::Half : FrameRateMode::Auto);
+		overBudgetFrames = underBudgetFrames = 0;
+	}
+
+	// Feeds the GPU time of the last rendered frame. Returns true when the divisor changed.
+	bool update(double gpuMs) {
+		int wanted = divisor;
+		if (mode == FrameRateMode::Full) { wanted = 1; }
+		else if (mode == FrameRateMode::Half) { wanted = 2; }
+		else {
+			// always measured against the full rate budget, going back only pays off once a frame fits one interval again
+			overBudgetFrames = gpuMs > budgetMs() ? overBudgetFrames + 1 : 0;
+			underBudgetFrames = gpuMs < 0.8 * budgetMs() ? underBudgetFrames + 1 : 0;
+			if (divisor == 1 && overBudgetFrames >= switchFrames) { wanted = 2; }
+			if (divisor == 2 && underBudgetFrames >= 2 * switchFrames) { wanted = 1; }
+		}
+		if (wanted == divisor) { return false; }
+		divisor = wanted;
+		overBudgetFrames = underBudgetFrames = 0;
+		std::cout << std::endl << "frame rate: " << refreshRate / divisor << " Hz (" << name() << ", eyes budget " << budgetMs() << " ms)" << std::endl;
+		return true;
+	}
+};
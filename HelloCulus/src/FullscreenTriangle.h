@@ -0,0 +1,51 @@
+#pragma once
+#include <glad/glad.h>
+
+#include "GlState.h"
+#include "ShaderSource.h"
+
+// Fullscreen draws of the fragment shader programs. A single triangle covering clip space [-1, 3]^2 is generated
+// from gl_VertexID with an empty vertex array: nothing is submitted per draw, it works in a core profile context,
+// and there's no quad diagonal where 2x2 pixel blocks get shaded twice.
+// legacyQuads draws the immediate mode GL_QUADS quad the app used before, compatibility profile only, for comparing
+// the driver's CPU time.
+struct FullscreenTriangle {
+	GLuint emptyVao = 0;
+	bool legacyQuads = false;
+	bool coreProfile = false;
+
+	FullscreenTriangle() {
+		glCreateVertexArrays(1, &emptyVao);
+	}
+
+	// Draws the program over the bound target's viewport at the given clip space depth.
+	void draw(GLuint program, float depth = 0.0f) const {
+		glState().useProgram(program);
+		glProgramUniform1i(program, glGetUniformLocation(program, "vertexPositions"), legacyQuads ? 1 : 0);
+		if (legacyQuads) {
+			glState().bindVertexArray(0);
+			glBegin(GL_QUADS);
+			glVertex3f(-1, -1, depth);
+			glVertex3f(1, -1, depth);
+			glVertex3f(1, 1, depth);
+			glVertex3f(-1, 1, depth);
+			glEnd();
+			return;
+		}
+		glProgramUniform1f(program, glGetUniformLocation(program, "fullscreenDepth"), depth);
+		glState().bindVertexArray(emptyVao);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+	}
+
+	// Both paths need a compatibility context for the comparison, core profile can only draw triangles.
+	bool toggleLegacyQuads() {
+		legacyQuads = !legacyQuads && !coreProfile;
+		return legacyQuads;
+	}
+};
+
+// Shared by every renderer, created once the context is current and left to it at exit
+inline FullscreenTriangle& fullscreen() {
+	static FullscreenTriangle triangle;
+	return triangle;
+}
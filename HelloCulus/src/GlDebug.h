@@ -0,0 +1,88 @@
+#pragma once
+#include <cstring>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+// Driver messages of a debug context (--gl-debug): shader recompiles, pipeline stalls, software fallbacks and errors.
+// Output is asynchronous so the driver isn't serialized with the app. The callback can come from driver threads,
+// it only appends to a bounded list that the frame loop prints between frames.
+struct GlDebugLog {
+	static const size_t maxPending = 64;
+	std::mutex mutex;
+	std::vector<std::string> pending;
+	int dropped = 0;
+	bool installed = false;
+
+	// Only performance messages and errors reach the callback, the rest is filtered by the driver
+	void install() {
+		GLint flags = 0;
+		glGetIntegerv(GL_CONTEXT_FLAGS, &flags);
+		if (!(flags & GL_CONTEXT_FLAG_DEBUG_BIT)) { std::cout << "No debug context, driver messages are limited" << std::endl; }
+		glDebugMessageCallback(callback, this);
+		glDebugMessageControl(GL_DONT_CARE, GL_DONT_CARE, GL_DONT_CARE, 0, nullptr, GL_FALSE);
+		glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_PERFORMANCE, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+		glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_ERROR, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+		glDebugMessageControl(GL_DONT_CARE, GL_DEBUG_TYPE_UNDEFINED_BEHAVIOR, GL_DONT_CARE, 0, nullptr, GL_TRUE);
+		glEnable(GL_DEBUG_OUTPUT);
+		glDisable(GL_DEBUG_OUTPUT_SYNCHRONOUS);
+		installed = true;
+	}
+
+	// Prints what arrived since the last call, each on its own line below the status line
+	void flush() {
+		std::vector<std::string> messages;
+		int lost = 0;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			messages.swap(pending);
+			std::swap(lost, dropped);
+		}
+		for (const std::string& m : messages) { std::cout << "\n" << m; }
+		if (lost) { std::cout << "\n" << lost << " more GL messages dropped"; }
+		if (!messages.empty() || lost) { std::cout << std::endl; }
+	}
+
+	~GlDebugLog() {
+		if (installed) { flush(); }
+	}
+
+private:
+	static void APIENTRY callback(GLenum source, GLenum type, GLuint id, GLenum severity, GLsizei length,
+		const GLchar* message, const void* userParam) {
+		GlDebugLog* log = (GlDebugLog*)userParam;
+		const char* kind = type == GL_DEBUG_TYPE_PERFORMANCE ? "performance" : type == GL_DEBUG_TYPE_ERROR ? "error" : "undefined behavior";
+		const char* level = severity == GL_DEBUG_SEVERITY_HIGH ? "high" : severity == GL_DEBUG_SEVERITY_MEDIUM ? "medium"
+			: severity == GL_DEBUG_SEVERITY_LOW ? "low" : "note";
+		std::lock_guard<std::mutex> lock(log->mutex);
+		if (log->pending.size() >= maxPending) { log->dropped++; return; }
+		log->pending.push_back(std::string("GL ") + kind + " (" + level + ", " + std::to_string(id) + "): "
+			+ std::string(message, length < 0 ? std::strlen(message) : (size_t)length));
+	}
+};
+
+inline GlDebugLog& glDebugLog() {
+	static GlDebugLog log;
+	return log;
+}
+
+// Names the GL commands issued in its scope in captures (RenderDoc, apitrace, Nsight). Groups nest.
+struct GlDebugGroup {
+	explicit GlDebugGroup(const char* name) {
+		glPushDebugGroup(GL_DEBUG_SOURCE_APPLICATION, 0, -1, name);
+	}
+
+	explicit GlDebugGroup(const std::string& name) :
+		GlDebugGroup(name.c_str()) {
+	}
+
+	~GlDebugGroup() {
+		glPopDebugGroup();
+	}
+
+	GlDebugGroup(const GlDebugGroup&) = delete;
+	GlDebugGroup& operator=(const GlDebugGroup&) = delete;
+};
@@ -0,0 +1,119 @@
+#pragma once
+#include <glad/glad.h>
+
+// Shadow of the GL state the renderers set while drawing: program, framebuffer, viewport, depth test and sRGB writes,
+// depth and color masks, depth function, vertex array and the textures on the sampled units. Calls that wouldn't
+// change anything are dropped before they reach the driver, and the current program or framebuffer is read from the
+// shadow instead of a glGet round trip. Every change of this state goes through glState(); invalidate() after
+// anything else may have touched it (it's done at the start of every frame).
+// Textures are bound with glBindTextureUnit, the active unit stays on scratchUnit for creating and uploading textures
+// with plain glBindTexture, so that doesn't disturb the bindings the shaders sample.
+struct GlStateCache {
+	static const GLuint unknown = 0xffffffff;
+	static const int textureUnits = 16; // passes on 0 to 3, tile culling on 7, noise on 8 to 11
+	static const int scratchUnit = 31;
+	GLuint program = unknown;
+	GLuint framebuffer = unknown; // bound to both draw and read
+	GLint viewportRect[4] = { -1, -1, -1, -1 };
+	GLuint vertexArray = unknown;
+	GLuint textures[textureUnits];
+	GLuint depthTest = unknown;
+	GLuint framebufferSrgb = unknown;
+	GLuint depthWrite = unknown;
+	GLuint colorWrite = unknown; // all four channels, nothing masks single ones
+	GLenum depthFunction = unknown;
+	// since the last endFrame()
+	int changes = 0;
+	int redundant = 0;
+	double smoothedChanges = 0.0;
+	double smoothedRedundant = 0.0;
+
+	GlStateCache() {
+		invalidate();
+	}
+
+	// Forgets the shadowed state, the next call of each kind goes to the driver.
+	void invalidate() {
+		program = framebuffer = vertexArray = unknown;
+		for (GLint& v : viewportRect) { v = -1; }
+		for (GLuint& t : textures) { t = unknown; }
+		depthTest = framebufferSrgb = depthWrite = colorWrite = depthFunction = unknown;
+		glActiveTexture(GL_TEXTURE0 + scratchUnit);
+	}
+
+	// A newly created program can reuse the name of a deleted one that is still the shadowed current program
+	void forgetProgram(GLuint id) {
+		if (program == id) { program = unknown; }
+	}
+
+	void useProgram(GLuint id) {
+		if (change(program, id)) { glUseProgram(id); }
+	}
+
+	void bindFramebuffer(GLuint id) {
+		if (change(framebuffer, id)) { glBindFramebuffer(GL_FRAMEBUFFER, id); }
+	}
+
+	void viewport(GLint x, GLint y, GLsizei w, GLsizei h) {
+		const GLint rect[4] = { x, y, w, h };
+		bool same = true;
+		for (int i = 0; i < 4; i++) { same = same && viewportRect[i] == rect[i]; }
+		if (same) { redundant++; return; }
+		for (int i = 0; i < 4; i++) { viewportRect[i] = rect[i]; }
+		changes++;
+		glViewport(x, y, w, h);
+	}
+
+	void enable(GLenum capability) { setCapability(capability, GL_TRUE); }
+	void disable(GLenum capability) { setCapability(capability, GL_FALSE); }
+
+	void depthMask(GLboolean write) {
+		if (change(depthWrite, (GLuint)write)) { glDepthMask(write); }
+	}
+
+	void colorMask(GLboolean write) {
+		if (change(colorWrite, (GLuint)write)) { glColorMask(write, write, write, write); }
+	}
+
+	void depthFunc(GLenum function) {
+		if (change(depthFunction, function)) { glDepthFunc(function); }
+	}
+
+	void bindVertexArray(GLuint id) {
+		if (change(vertexArray, id)) { glBindVertexArray(id); }
+	}
+
+	void bindTexture(int unit, GLuint id) {
+		if (unit >= textureUnits) { changes++; glBindTextureUnit(unit, id); return; }
+		if (change(textures[unit], id)) { glBindTextureUnit(unit, id); }
+	}
+
+	void endFrame() {
+		smoothedChanges = smoothedChanges == 0.0 ? changes : smoothedChanges * 0.95 + changes * 0.05;
+		smoothedRedundant = smoothedRedundant == 0.0 ? redundant : smoothedRedundant * 0.95 + redundant * 0.05;
+		changes = redundant = 0;
+	}
+
+private:
+	// true when the call has to go to the driver
+	bool change(GLuint& shadow, GLuint value) {
+		if (shadow == value) { redundant++; return false; }
+		shadow = value;
+		changes++;
+		return true;
+	}
+
+	void setCapability(GLenum capability, GLboolean on) {
+		GLuint* shadow = capability == GL_DEPTH_TEST ? &depthTest : capability == GL_FRAMEBUFFER_SRGB ? &framebufferSrgb : nullptr;
+		if (shadow && !change(*shadow, (GLuint)on)) { return; }
+		if (!shadow) { changes++; }
+		if (on) { glEnable(capability); }
+		else { glDisable(capability); }
+	}
+};
+
+// Created right after the context, before anything binds textures
+inline GlStateCache& glState() {
+	static GlStateCache cache;
+	return cache;
+}
@@ -0,0 +1,61 @@
+#pragma once
+#include <glad/glad.h>
+
+// Measures GPU time between begin() and end() with GL_TIME_ELAPSED queries.
+// Queries are kept in a small ring and read back a few frames late, so measuring never stalls the CPU.
+// Only one GpuTimer can be between begin() and end() at a time (GL doesn't nest elapsed-time queries).
+struct GpuTimer {
+	static const int ringSize = 4;
+	GLuint queries[ringSize];
+	bool pending[ringSize];
+	int current;
+	double lastMs;
+	double smoothedMs;
+	double totalMs; // sum of every collected measurement, for utilization over a period
+	long long collected;
+
+	GpuTimer() :
+		current(0),
+		lastMs(0.0),
+		smoothedMs(0.0),
+		totalMs(0.0),
+		collected(0) {
+		glGenQueries(ringSize, queries);
+		for (int i = 0; i < ringSize; i++) { pending[i] = false; }
+	}
+
+	~GpuTimer() {
+		glDeleteQueries(ringSize, queries);
+	}
+
+	void begin() {
+		// Slot is still in flight after a full trip around the ring: drop it instead of waiting.
+		pending[current] = false;
+		glBeginQuery(GL_TIME_ELAPSED, queries[current]);
+	}
+
+	void end() {
+		glEndQuery(GL_TIME_ELAPSED);
+		pending[current] = true;
+		current = (current + 1) % ringSize;
+		poll();
+	}
+
+	// Collects every finished query, oldest first.
+	void poll() {
+		for (int i = 0; i < ringSize; i++) {
+			int slot = (current + i) % ringSize;
+			if (!pending[slot]) { continue; }
+			GLint available = 0;
+			glGetQueryObjectiv(queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+			if (!available) { break; }
+			GLuint64 ns = 0;
+			glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &ns);
+			pending[slot] = false;
+			lastMs = ns / 1e6;
+			totalMs += lastMs;
+			collected++;
+			smoothedMs = smoothedMs == 0.0 ? lastMs : smoothedMs * 0.95 + lastMs * 0.05;
+		}
+	}
+};
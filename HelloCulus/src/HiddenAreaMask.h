@@ -0,0 +1,143 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "GlDebug.h"
+#include "GlState.h"
+#include "ShaderSource.h"
+
+#include <OVR_CAPI.h>
+#include <Extras/OVR_Math.h>
+
+// Region of an eye buffer that can't be seen through the lens, as a triangle mesh in [0, 1] texture coordinates
+// (origin at bottom left). Drawn into the depth buffer at the near plane before the fullscreen raymarch triangle,
+// so early depth testing rejects those fragments before the fragment shader runs.
+struct HiddenAreaMask {
+	std::vector<ovrVector2f> vertices;
+	std::vector<uint16_t> indices;
+	bool simulated;
+	GLuint vaoId = 0;
+	GLuint bufferIds[2] = { 0, 0 }; // clip space positions at the near plane, indices
+	GLuint depthProg = 0;
+
+	HiddenAreaMask(ovrSession session, ovrEyeType eye, const ovrFovPort& fov, const ovrQuatf& hmdToEyeRotation) :
+		simulated(false) {
+		ovrFovStencilDesc desc = {};
+		desc.StencilType = ovrFovStencil_HiddenArea;
+		desc.StencilFlags = ovrFovStencilFlag_MeshOriginAtBottomLeft;
+		desc.Eye = eye;
+		desc.FovPort = fov;
+		desc.HmdToEyeRotation = hmdToEyeRotation;
+
+		// First call with empty buffers to get the sizes, second one to fill them.
+		ovrFovStencilMeshBuffer mesh = {};
+		ovrResult result = ovr_GetFovStencil(session, &desc, &mesh);
+		if (OVR_SUCCESS(result) && mesh.UsedVertexCount > 0 && mesh.UsedIndexCount > 0) {
+			vertices.resize(mesh.UsedVertexCount);
+			indices.resize(mesh.UsedIndexCount);
+			mesh.AllocVertexCount = (int)vertices.size();
+			mesh.VertexBuffer = &vertices[0];
+			mesh.AllocIndexCount = (int)indices.size();
+			mesh.IndexBuffer = &indices[0];
+			result = ovr_GetFovStencil(session, &desc, &mesh);
+		}
+		if (!OVR_SUCCESS(result) || vertices.empty()) {
+			simulate(fov);
+		}
+		upload();
+	}
+
+	~HiddenAreaMask() {
+		glDeleteVertexArrays(1, &vaoId);
+		glDeleteBuffers(2, bufferIds);
+		glDeleteProgram(depthProg);
+	}
+
+	// The mesh never changes, it's drawn from buffers with a depth only program
+	void upload() {
+		std::vector<float> positions;
+		for (const ovrVector2f& v : vertices) { positions.insert(positions.end(), { v.x * 2.0f - 1.0f, v.y * 2.0f - 1.0f, -1.0f }); }
+		glCreateBuffers(2, bufferIds);
+		glNamedBufferStorage(bufferIds[0], positions.size() * sizeof(float), positions.data(), 0);
+		glNamedBufferStorage(bufferIds[1], indices.size() * sizeof(uint16_t), indices.data(), 0);
+		glCreateVertexArrays(1, &vaoId);
+		glVertexArrayVertexBuffer(vaoId, 0, bufferIds[0], 0, 3 * sizeof(float));
+		glVertexArrayElementBuffer(vaoId, bufferIds[1]);
+		glEnableVertexArrayAttrib(vaoId, 0);
+		glVertexArrayAttribFormat(vaoId, 0, 3, GL_FLOAT, GL_FALSE, 0);
+		glVertexArrayAttribBinding(vaoId, 0, 0);
+		depthProg = linkFragmentProgram("#version 410\nuniform float depth = 0.0;\nvoid main() { gl_FragDepth = depth; }\n");
+		glProgramUniform1i(depthProg, glGetUniformLocation(depthProg, "vertexPositions"), 1);
+	}
+
+	// Stand-in when the runtime can't provide a stencil mesh: everything outside an ellipse around the lens center.
+	void simulate(const ovrFovPort& fov) {
+		simulated = true;
+		vertices.clear();
+		indices.clear();
+		const OVR::Vector2f center(fov.LeftTan / (fov.LeftTan + fov.RightTan), fov.DownTan / (fov.UpTan + fov.DownTan));
+		const float radius = 0.62f;
+		const int segments = 64;
+		for (int i = 0; i < segments; i++) {
+			float angle = 2.0f * 3.14159265f * i / segments;
+			OVR::Vector2f dir(std::cos(angle), std::sin(angle));
+			// distance along dir from the center to the edge of the [0, 1] square
+			float tx = dir.x > 0 ? (1.0f - center.x) / dir.x : (dir.x < 0 ? -center.x / dir.x : 1e9f);
+			float ty = dir.y > 0 ? (1.0f - center.y) / dir.y : (dir.y < 0 ? -center.y / dir.y : 1e9f);
+			float edge = std::fmin(tx, ty);
+			OVR::Vector2f inner = center + dir * std::fmin(radius, edge);
+			OVR::Vector2f outer = center + dir * edge;
+			vertices.push_back({ inner.x, inner.y });
+			vertices.push_back({ outer.x, outer.y });
+		}
+		// Corners of the square, so the outer ring doesn't cut them off between two segment edges.
+		const OVR::Vector2f corners[4] = { { 1, 1 }, { 0, 1 }, { 0, 0 }, { 1, 0 } };
+		for (int i = 0; i < segments; i++) {
+			uint16_t i0 = (uint16_t)(2 * i), o0 = i0 + 1;
+			uint16_t i1 = (uint16_t)(2 * ((i + 1) % segments)), o1 = i1 + 1;
+			indices.insert(indices.end(), { i0, o0, o1, i0, o1, i1 });
+		}
+		for (int c = 0; c < 4; c++) {
+			// fill the gap between the corner and the two outer points around it
+			OVR::Vector2f toCorner = corners[c] - center;
+			float angle = std::atan2(toCorner.y, toCorner.x);
+			if (angle < 0) { angle += 2.0f * 3.14159265f; }
+			int i = (int)(angle / (2.0f * 3.14159265f) * segments) % segments;
+			uint16_t o0 = (uint16_t)(2 * i + 1), o1 = (uint16_t)(2 * ((i + 1) % segments) + 1);
+			uint16_t corner = (uint16_t)vertices.size();
+			vertices.push_back({ corners[c].x, corners[c].y });
+			indices.insert(indices.end(), { o0, corner, o1 });
+		}
+	}
+
+	// Fraction of the eye buffer covered by the mask.
+	double coverage() const {
+		double area = 0.0;
+		for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+			const ovrVector2f& a = vertices[indices[i]];
+			const ovrVector2f& b = vertices[indices[i + 1]];
+			const ovrVector2f& c = vertices[indices[i + 2]];
+			area += std::fabs((b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y)) * 0.5;
+		}
+		return area;
+	}
+
+	// Writes near plane depth (or the given one) where the lens hides the image. Expects the render surface to be bound.
+	void primeDepth(float depth = 0.0f) const {
+		GlDebugGroup group("hidden area depth");
+		glState().useProgram(depthProg);
+		glProgramUniform1f(depthProg, glGetUniformLocation(depthProg, "depth"), depth);
+		glState().colorMask(GL_FALSE);
+		glState().enable(GL_DEPTH_TEST);
+		glState().depthFunc(GL_ALWAYS);
+		glState().depthMask(GL_TRUE);
+		glState().bindVertexArray(vaoId);
+		glDrawElements(GL_TRIANGLES, (GLsizei)indices.size(), GL_UNSIGNED_SHORT, nullptr);
+		glState().colorMask(GL_TRUE);
+		glState().depthFunc(GL_LESS);
+	}
+};
@@ -0,0 +1,73 @@
+#pragma once
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <Extras/OVR_Math.h>
+
+#include "InstanceGrid.h"
+#include "QualitySweep.h"
+#include "ShaderSource.h"
+
+// Offscreen scaling test of an "// @instances" shader: GPU time of the grid traversal from a hundred to a hundred
+// thousand instances, against testing every instance on every step (built with INSTANCE_BRUTE_FORCE) for the counts
+// where that's still feasible. Both render the same image, the PSNR between them is printed as a check.
+// Results go to "<shader>.instances.csv".
+struct InstanceBenchmark {
+	std::vector<int> counts = { 100, 1000, 10000, 100000 };
+	int bruteForceLimit = 1000; // beyond this a single brute force frame can trip the driver's timeout
+	QualitySweep renderer;      // fixed camera, offscreen target and GPU timing
+	InstanceGrid grid;
+
+	InstanceBenchmark(OVR::Sizei size, int timedFrames) :
+		renderer(size, timedFrames) {
+	}
+
+	double render(GLuint programId, std::vector<unsigned char>& pixels) {
+		grid.setUniforms(programId);
+		// eye height above the ground, the scene is centered on the origin
+		glProgramUniform3f(programId, glGetUniformLocation(programId, "ro"), 0.0f, 0.6f, 0.0f);
+		return renderer.render(programId, pixels);
+	}
+
+	int run(const std::string& filepath) {
+		ShaderSource source;
+		if (!source.load(filepath)) { return EXIT_FAILURE; }
+		if (!source.findDirective("instances")) { std::cout << "No // @instances directive in " << filepath << std::endl; return EXIT_FAILURE; }
+		GLuint gridProg = linkFragmentProgram(source.build({ { "INSTANCE_GRID", "1" } }));
+		GLuint bruteProg = linkFragmentProgram(source.build({ { "INSTANCE_GRID", "1" }, { "INSTANCE_BRUTE_FORCE", "1" } }));
+		if (!gridProg || !bruteProg) { return EXIT_FAILURE; }
+
+		std::string csvPath = filepath + ".instances.csv";
+		std::ofstream csv(csvPath);
+		csv << "instances,cells,build_ms,grid_ms,brute_force_ms,psnr" << std::endl;
+		std::vector<unsigned char> gridPixels, brutePixels;
+		for (int count : counts) {
+			grid.build(grid.scatter(count, grid.seed));
+			grid.printSummary();
+			grid.bind();
+			double gridMs = render(gridProg, gridPixels);
+			std::cout << std::fixed << std::setprecision(3) << "  " << std::setw(7) << count << " instances: grid " << gridMs << " ms";
+			csv << count << "," << grid.dims[0] * grid.dims[1] * grid.dims[2] << "," << grid.buildMs << "," << gridMs;
+			if (count <= bruteForceLimit) {
+				double bruteMs = render(bruteProg, brutePixels);
+				double psnr = QualitySweep::psnr(brutePixels, gridPixels);
+				std::cout << ", brute force " << bruteMs << " ms, PSNR " << psnr << " dB";
+				csv << "," << bruteMs << "," << psnr;
+			}
+			else {
+				csv << ",,";
+			}
+			std::cout << std::endl;
+			csv << std::endl;
+		}
+		std::cout << "Wrote " << counts.size() << " counts to " << csvPath << std::endl;
+		glDeleteProgram(gridProg);
+		glDeleteProgram(bruteProg);
+		return EXIT_SUCCESS;
+	}
+};
@@ -0,0 +1,197 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <Extras/OVR_Math.h>
+
+#include "ShaderSource.h"
+
+// Large scenes of SDF primitive instances for shaders that declare "// @instances COUNT [SEED]". The instances are
+// scattered by the app, binned into a uniform grid on the CPU, and the shader (built with INSTANCE_GRID) marches with
+// gridMarch() from the prelude: it walks the cells along the ray and evaluates only the instances overlapping the
+// current cell, so the cost of a step doesn't grow with the instance count.
+// Instances, cells and cell lists are shader storage buffers on bindings 1 to 3, 0 is the cost heatmap's.
+enum class InstanceType { Sphere = 0, Box = 1, Torus = 2 };
+
+struct SdfInstance {
+	InstanceType type;
+	OVR::Vector3f position;
+	OVR::Quatf rotation;
+	OVR::Vector3f size; // sphere: radius in x, box: half extents, torus: major and minor radius in x and y
+	float material;
+
+	float boundingRadius() const {
+		switch (type) {
+		case InstanceType::Sphere: return size.x;
+		case InstanceType::Box: return size.Length();
+		default: return size.x + size.y;
+		}
+	}
+};
+
+struct InstanceGrid {
+	static const GLuint firstBinding = 1; // instances, cells and cell lists on 1, 2 and 3
+	int count = 0;
+	unsigned seed = 1;
+	float spacing = 1.5f; // average distance between instances on the ground, the scene grows with the count
+	OVR::Vector3f gridMin;
+	float cellSize = 1.0f;
+	int dims[3] = { 0, 0, 0 };
+	size_t listedInstances = 0; // instances in all cell lists, an instance is listed in every cell it overlaps
+	int occupiedCells = 0;
+	double buildMs = 0.0;
+	GLuint bufferIds[3] = { 0, 0, 0 };
+
+	InstanceGrid() {
+		glCreateBuffers(3, bufferIds);
+	}
+
+	~InstanceGrid() {
+		glDeleteBuffers(3, bufferIds);
+	}
+
+	bool active() const { return count > 0; }
+
+	// Builds the shader's scene unless it's the current one already. Returns whether the shader has instances.
+	bool load(const ShaderSource& source) {
+		const ShaderDirective* d = source.findDirective("instances");
+		if (!d || d->args.empty()) { count = 0; return false; }
+		// malformed numbers keep the current scene
+		int wanted = count;
+		if (d->number(0, wanted)) { wanted = std::max(1, wanted); }
+		unsigned wantedSeed = d->args.size() > 1 ? seed : 1u;
+		d->number(1, wantedSeed);
+		if (wanted == 0) { return false; }
+		if (wanted != count || wantedSeed != seed) {
+			seed = wantedSeed;
+			build(scatter(wanted, seed));
+			printSummary();
+		}
+		return true;
+	}
+
+	// Random spheres, boxes and tori standing on a square ground patch, sized for the given count at constant density
+	std::vector<SdfInstance> scatter(int n, unsigned s) const {
+		std::mt19937 rng(s);
+		std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+		const float extent = 0.5f * spacing * std::sqrt((float)n);
+		std::vector<SdfInstance> instances(n);
+		for (SdfInstance& inst : instances) {
+			inst.type = InstanceType(rng() % 3);
+			float scale = 0.15f + 0.35f * unit(rng);
+			inst.size = inst.type == InstanceType::Box ? OVR::Vector3f(scale, scale * (0.5f + unit(rng)), scale * (0.5f + unit(rng)))
+				: inst.type == InstanceType::Torus ? OVR::Vector3f(scale, scale * 0.3f, 0.0f) : OVR::Vector3f(scale, 0.0f, 0.0f);
+			inst.position = OVR::Vector3f((2.0f * unit(rng) - 1.0f) * extent, -1.0f + 3.0f * unit(rng), (2.0f * unit(rng) - 1.0f) * extent);
+			OVR::Vector3f axis(unit(rng) - 0.5f, unit(rng) - 0.5f, unit(rng) - 0.5f);
+			inst.rotation = OVR::Quatf(axis.LengthSq() > 1e-6f ? axis.Normalized() : OVR::Vector3f(0, 1, 0), 6.2831853f * unit(rng));
+			inst.material = unit(rng);
+		}
+		return instances;
+	}
+
+	// Bins the instances by their bounding spheres and uploads everything
+	void build(const std::vector<SdfInstance>& instances) {
+		auto begin = std::chrono::steady_clock::now();
+		count = (int)instances.size();
+		OVR::Vector3f lo(1e30f, 1e30f, 1e30f), hi(-1e30f, -1e30f, -1e30f);
+		for (const SdfInstance& inst : instances) {
+			float r = inst.boundingRadius();
+			lo = OVR::Vector3f(std::min(lo.x, inst.position.x - r), std::min(lo.y, inst.position.y - r), std::min(lo.z, inst.position.z - r));
+			hi = OVR::Vector3f(std::max(hi.x, inst.position.x + r), std::max(hi.y, inst.position.y + r), std::max(hi.z, inst.position.z + r));
+		}
+		// about two instances per cell, and never more than 256 cells along an axis
+		OVR::Vector3f extent = hi - lo;
+		cellSize = std::cbrt(extent.x * extent.y * extent.z / std::max(1, count) * 2.0f);
+		cellSize = std::max(cellSize, std::max(extent.x, std::max(extent.y, extent.z)) / 256.0f);
+		gridMin = lo;
+		dims[0] = std::max(1, (int)std::ceil(extent.x / cellSize));
+		dims[1] = std::max(1, (int)std::ceil(extent.y / cellSize));
+		dims[2] = std::max(1, (int)std::ceil(extent.z / cellSize));
+
+		auto cellRange = [&](const SdfInstance& inst, int axis, float center) {
+			float r = inst.boundingRadius() + 0.01f; // normals are sampled slightly off the surface
+			int a = std::max(0, (int)std::floor((center - r - gridMin[axis]) / cellSize));
+			int b = std::min(dims[axis] - 1, (int)std::floor((center + r - gridMin[axis]) / cellSize));
+			return std::make_pair(a, b);
+		};
+		auto forEachCell = [&](const SdfInstance& inst, const std::function<void(int)>& fn) {
+			auto rx = cellRange(inst, 0, inst.position.x);
+			auto ry = cellRange(inst, 1, inst.position.y);
+			auto rz = cellRange(inst, 2, inst.position.z);
+			for (int z = rz.first; z <= rz.second; z++) {
+				for (int y = ry.first; y <= ry.second; y++) {
+					for (int x = rx.first; x <= rx.second; x++) { fn((z * dims[1] + y) * dims[0] + x); }
+				}
+			}
+		};
+
+		// counting sort of (cell, instance) pairs: first index and count per cell, x fastest
+		const int cellCount = dims[0] * dims[1] * dims[2];
+		std::vector<GLint> cells(cellCount * 2, 0);
+		for (const SdfInstance& inst : instances) { forEachCell(inst, [&](int c) { cells[c * 2 + 1]++; }); }
+		GLint first = 0;
+		occupiedCells = 0;
+		for (int c = 0; c < cellCount; c++) {
+			cells[c * 2] = first;
+			first += cells[c * 2 + 1];
+			occupiedCells += cells[c * 2 + 1] > 0;
+			cells[c * 2 + 1] = 0;
+		}
+		listedInstances = first;
+		std::vector<GLint> lists(std::max<size_t>(listedInstances, 1));
+		for (int i = 0; i < count; i++) {
+			forEachCell(instances[i], [&](int c) { lists[cells[c * 2] + cells[c * 2 + 1]++] = i; });
+		}
+
+		// 3 vec4 per instance: position.xyz type, rotation quaternion, size.xyz material
+		std::vector<float> data(count * 12);
+		for (int i = 0; i < count; i++) {
+			const SdfInstance& inst = instances[i];
+			float* t = &data[i * 12];
+			t[0] = inst.position.x; t[1] = inst.position.y; t[2] = inst.position.z; t[3] = (float)inst.type;
+			t[4] = inst.rotation.x; t[5] = inst.rotation.y; t[6] = inst.rotation.z; t[7] = inst.rotation.w;
+			t[8] = inst.size.x; t[9] = inst.size.y; t[10] = inst.size.z; t[11] = inst.material;
+		}
+
+		GLint64 maxBytes = 0;
+		glGetInteger64v(GL_MAX_SHADER_STORAGE_BLOCK_SIZE, &maxBytes);
+		const size_t largest = std::max(data.size() * sizeof(float), std::max(cells.size(), lists.size()) * sizeof(GLint));
+		if ((GLint64)largest > maxBytes) {
+			std::cout << "Instance grid exceeds GL_MAX_SHADER_STORAGE_BLOCK_SIZE (" << maxBytes << " bytes)" << std::endl;
+		}
+		// std430 arrays of vec4, ivec2 and int are tightly packed like these
+		glNamedBufferData(bufferIds[0], data.size() * sizeof(float), data.data(), GL_STATIC_DRAW);
+		glNamedBufferData(bufferIds[1], cells.size() * sizeof(GLint), cells.data(), GL_STATIC_DRAW);
+		glNamedBufferData(bufferIds[2], lists.size() * sizeof(GLint), lists.data(), GL_STATIC_DRAW);
+		buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+	}
+
+	void printSummary() const {
+		std::cout << "Instance grid: " << count << " instances in " << dims[0] << "x" << dims[1] << "x" << dims[2] << " cells of "
+			<< cellSize << " m, " << occupiedCells << " occupied, " << (occupiedCells ? (double)listedInstances / occupiedCells : 0.0)
+			<< " instances per occupied cell, built in " << buildMs << " ms" << std::endl;
+	}
+
+	// Binds the buffers. Once per frame, every program reads them from the same bindings.
+	void bind() const {
+		for (GLuint i = 0; i < 3; i++) {
+			glBindBufferBase(GL_SHADER_STORAGE_BUFFER, firstBinding + i, bufferIds[i]);
+		}
+	}
+
+	void setUniforms(GLuint program) const {
+		glProgramUniform3f(program, glGetUniformLocation(program, "gridMin"), gridMin.x, gridMin.y, gridMin.z);
+		glProgramUniform1f(program, glGetUniformLocation(program, "gridCellSize"), cellSize);
+		glProgramUniform3i(program, glGetUniformLocation(program, "gridDims"), dims[0], dims[1], dims[2]);
+		glProgramUniform1i(program, glGetUniformLocation(program, "instanceCount"), count);
+	}
+};
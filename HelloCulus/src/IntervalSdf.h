@@ -0,0 +1,116 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <string>
+
+// Range [lo, hi] of the values an expression takes over a region. Evaluated with intervals, an SDF is bounded over a
+// whole box of points at once: lo above the hit threshold proves there's no surface in the box.
+// Bounds are conservative but not tight, and rounded to nearest like the GPU, callers keep a margin.
+struct Interval {
+	float lo;
+	float hi;
+
+	Interval(float v = 0.0f) : lo(v), hi(v) {}
+	Interval(float lo, float hi) : lo(lo), hi(hi) {}
+
+	static Interval everything() { return { -std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity() }; }
+};
+
+// 0 * inf is 0 for bounds, a box can reach infinity along a ray whose direction has a zero component
+inline float boundProduct(float a, float b) { return (a == 0.0f || b == 0.0f) ? 0.0f : a * b; }
+
+inline Interval operator+(const Interval& a, const Interval& b) { return { a.lo + b.lo, a.hi + b.hi }; }
+inline Interval operator-(const Interval& a, const Interval& b) { return { a.lo - b.hi, a.hi - b.lo }; }
+inline Interval operator-(const Interval& a) { return { -a.hi, -a.lo }; }
+
+inline Interval operator*(const Interval& a, const Interval& b) {
+	float p[4] = { boundProduct(a.lo, b.lo), boundProduct(a.lo, b.hi), boundProduct(a.hi, b.lo), boundProduct(a.hi, b.hi) };
+	return { std::min(std::min(p[0], p[1]), std::min(p[2], p[3])), std::max(std::max(p[0], p[1]), std::max(p[2], p[3])) };
+}
+
+inline Interval min(const Interval& a, const Interval& b) { return { std::min(a.lo, b.lo), std::min(a.hi, b.hi) }; }
+inline Interval max(const Interval& a, const Interval& b) { return { std::max(a.lo, b.lo), std::max(a.hi, b.hi) }; }
+
+inline Interval abs(const Interval& a) {
+	if (a.lo >= 0.0f) { return a; }
+	if (a.hi <= 0.0f) { return -a; }
+	return { 0.0f, std::max(-a.lo, a.hi) };
+}
+
+// x * x, tighter than a product because both factors are the same value
+inline Interval sqr(const Interval& a) {
+	Interval m = abs(a);
+	return { m.lo * m.lo, m.hi * m.hi };
+}
+
+inline Interval sqrt(const Interval& a) { return { std::sqrt(std::max(a.lo, 0.0f)), std::sqrt(std::max(a.hi, 0.0f)) }; }
+
+// Only for intervals that don't contain 0, everything otherwise
+inline Interval reciprocal(const Interval& a) {
+	if (a.lo > 0.0f || a.hi < 0.0f) { return { 1.0f / a.hi, 1.0f / a.lo }; }
+	return Interval::everything();
+}
+
+inline Interval sin(const Interval& a) {
+	const float twoPi = 6.283185307f;
+	if (!(a.hi - a.lo < twoPi)) { return { -1.0f, 1.0f }; } // also infinite ones
+	float lo = std::min(std::sin(a.lo), std::sin(a.hi));
+	float hi = std::max(std::sin(a.lo), std::sin(a.hi));
+	// extrema at pi/2 + 2k pi (1) and -pi/2 + 2k pi (-1) within the interval
+	if (std::floor((a.hi - 1.570796327f) / twoPi) > std::floor((a.lo - 1.570796327f) / twoPi)) { hi = 1.0f; }
+	if (std::floor((a.hi + 1.570796327f) / twoPi) > std::floor((a.lo + 1.570796327f) / twoPi)) { lo = -1.0f; }
+	return { lo, hi };
+}
+
+inline Interval cos(const Interval& a) { return sin(a + Interval(1.570796327f)); }
+
+struct IntervalVec3 {
+	Interval x;
+	Interval y;
+	Interval z;
+};
+
+inline IntervalVec3 operator+(const IntervalVec3& a, const IntervalVec3& b) { return { a.x + b.x, a.y + b.y, a.z + b.z }; }
+inline IntervalVec3 operator-(const IntervalVec3& a, const IntervalVec3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+inline IntervalVec3 operator*(const IntervalVec3& a, const Interval& s) { return { a.x * s, a.y * s, a.z * s }; }
+inline IntervalVec3 abs(const IntervalVec3& a) { return { abs(a.x), abs(a.y), abs(a.z) }; }
+inline IntervalVec3 max(const IntervalVec3& a, const Interval& b) { return { max(a.x, b), max(a.y, b), max(a.z, b) }; }
+inline Interval length(const IntervalVec3& a) { return sqrt(sqr(a.x) + sqr(a.y) + sqr(a.z)); }
+inline IntervalVec3 normalize(const IntervalVec3& a) { return a * reciprocal(length(a)); }
+
+// Interval versions of the shaders' SDF primitives, same names and arguments
+
+inline Interval sdSphere(const IntervalVec3& p, float s) { return length(p) - Interval(s); }
+
+inline Interval sdPlane(const IntervalVec3& p) { return p.y; }
+
+inline Interval sdBox(const IntervalVec3& p, const IntervalVec3& b) {
+	IntervalVec3 d = abs(p) - b;
+	return min(max(d.x, max(d.y, d.z)), Interval(0.0f)) + length(max(d, Interval(0.0f)));
+}
+
+inline Interval gyroid(const IntervalVec3& p, float s) {
+	return sin(p.x * s) * cos(p.y * s) + sin(p.y * s) * cos(p.z * s) + sin(p.z * s) * cos(p.x * s);
+}
+
+// CPU mirror of a shader's map() over a box of points at the given time, as named by "// @cull NAME".
+typedef std::function<Interval(const IntervalVec3& p, float time)> IntervalScene;
+
+inline IntervalScene intervalScene(const std::string& name) {
+	if (name == "default") {
+		// default.glsl
+		return [](const IntervalVec3& p, float time) {
+			Interval d = sdSphere(p - IntervalVec3{ -1.0f + std::sin(time) * 2.0f, 0.0f, -5.0f }, 1.0f);
+			d = min(d, sdSphere(p - IntervalVec3{ 2.0f, 0.0f, -3.0f }, 1.0f));
+			d = min(d, sdSphere(p - IntervalVec3{ -2.0f, 0.0f, -2.0f }, 1.0f));
+			return min(d, p.y + Interval(1.0f));
+		};
+	}
+	if (name == "gyroid") {
+		// gyroid.glsl, only the gyroid reaches its result
+		return [](const IntervalVec3& p, float) { return gyroid(p, 1.0f); };
+	}
+	return nullptr;
+}
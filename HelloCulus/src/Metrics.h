@@ -0,0 +1,197 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <winsock2.h>
+
+// Counters, gauges and histograms updated on the render thread and served in Prometheus text format to scrapers on
+// localhost (--metrics-port). Every metric has a single writer, the render thread, so updates are plain atomic stores
+// and increments without locks. The server thread only loads them, a scrape may see a histogram between two updates.
+struct MetricCounter {
+	std::atomic<uint64_t> value{ 0 };
+
+	void add(uint64_t n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+	// for totals counted elsewhere, e.g. by the runtime
+	void set(uint64_t total) { value.store(total, std::memory_order_relaxed); }
+};
+
+struct MetricGauge {
+	std::atomic<double> value{ 0.0 };
+
+	void set(double v) { value.store(v, std::memory_order_relaxed); }
+};
+
+struct MetricHistogram {
+	std::vector<double> bounds; // upper bounds of the buckets, +Inf is implied
+	std::unique_ptr<std::atomic<uint64_t>[]> buckets;
+	std::atomic<double> sum{ 0.0 };
+
+	explicit MetricHistogram(const std::vector<double>& upperBounds) :
+		bounds(upperBounds),
+		buckets(new std::atomic<uint64_t>[upperBounds.size() + 1]) {
+		for (size_t i = 0; i <= bounds.size(); i++) { buckets[i].store(0); }
+	}
+
+	void observe(double v) {
+		size_t i = 0;
+		while (i < bounds.size() && v > bounds[i]) { i++; }
+		buckets[i].fetch_add(1, std::memory_order_relaxed);
+		// single writer, no read-modify-write race
+		sum.store(sum.load(std::memory_order_relaxed) + v, std::memory_order_relaxed);
+	}
+};
+
+// Registration happens at startup, before the server runs, the metrics don't move afterwards.
+struct MetricsRegistry {
+	enum class Kind { Counter, Gauge, Histogram };
+	struct Entry {
+		std::string name;
+		std::string help;
+		Kind kind;
+		size_t index;
+	};
+	std::vector<Entry> entries;
+	std::deque<MetricCounter> counters;
+	std::deque<MetricGauge> gauges;
+	std::deque<MetricHistogram> histograms;
+
+	MetricCounter& counter(const std::string& name, const std::string& help) {
+		entries.push_back({ name, help, Kind::Counter, counters.size() });
+		counters.emplace_back();
+		return counters.back();
+	}
+
+	MetricGauge& gauge(const std::string& name, const std::string& help) {
+		entries.push_back({ name, help, Kind::Gauge, gauges.size() });
+		gauges.emplace_back();
+		return gauges.back();
+	}
+
+	MetricHistogram& histogram(const std::string& name, const std::string& help, const std::vector<double>& bounds) {
+		entries.push_back({ name, help, Kind::Histogram, histograms.size() });
+		histograms.emplace_back(bounds);
+		return histograms.back();
+	}
+
+	// Prometheus text exposition format 0.0.4
+	std::string text() const {
+		std::ostringstream out;
+		for (const Entry& e : entries) {
+			out << "# HELP " << e.name << " " << e.help << "\n";
+			switch (e.kind) {
+			case Kind::Counter:
+				out << "# TYPE " << e.name << " counter\n" << e.name << " " << counters[e.index].value.load(std::memory_order_relaxed) << "\n";
+				break;
+			case Kind::Gauge:
+				out << "# TYPE " << e.name << " gauge\n" << e.name << " " << gauges[e.index].value.load(std::memory_order_relaxed) << "\n";
+				break;
+			case Kind::Histogram: {
+				const MetricHistogram& h = histograms[e.index];
+				out << "# TYPE " << e.name << " histogram\n";
+				uint64_t cumulative = 0;
+				for (size_t i = 0; i <= h.bounds.size(); i++) {
+					cumulative += h.buckets[i].load(std::memory_order_relaxed);
+					out << e.name << "_bucket{le=\"";
+					if (i < h.bounds.size()) { out << h.bounds[i]; }
+					else { out << "+Inf"; }
+					out << "\"} " << cumulative << "\n";
+				}
+				// the +Inf bucket is the count, so both stay consistent within a scrape
+				out << e.name << "_sum " << h.sum.load(std::memory_order_relaxed) << "\n" << e.name << "_count " << cumulative << "\n";
+				break;
+			}
+			}
+		}
+		return out.str();
+	}
+};
+
+// Answers every HTTP request on 127.0.0.1:port with the registry's text, e.g. GET /metrics. One connection at a time,
+// the thread waits in select() with a timeout so it notices stop(), and gives up on clients that stall for a second.
+struct MetricsServer {
+	static const int clientTimeoutMs = 1000;
+	const MetricsRegistry& registry;
+	int port;
+	std::atomic<bool> running{ false };
+	std::thread thread;
+	SOCKET listener = INVALID_SOCKET;
+
+	MetricsServer(const MetricsRegistry& registry, int port) :
+		registry(registry),
+		port(port) {
+	}
+
+	~MetricsServer() {
+		stop();
+	}
+
+	bool start() {
+		if (port < 1 || port > 65535) { std::cout << "No port " << port << ", no metrics" << std::endl; return false; }
+		WSADATA wsa;
+		if (WSAStartup(MAKEWORD(2, 2), &wsa) != 0) { std::cout << "Winsock unavailable, no metrics" << std::endl; return false; }
+		listener = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
+		sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_port = htons((unsigned short)port);
+		address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		if (listener == INVALID_SOCKET || bind(listener, (const sockaddr*)&address, sizeof(address)) == SOCKET_ERROR
+			|| listen(listener, SOMAXCONN) == SOCKET_ERROR) {
+			std::cout << "Can't listen on 127.0.0.1:" << port << ", no metrics" << std::endl;
+			if (listener != INVALID_SOCKET) { closesocket(listener); }
+			listener = INVALID_SOCKET;
+			WSACleanup();
+			return false;
+		}
+		running = true;
+		thread = std::thread([this] { serve(); });
+		std::cout << "Metrics on http://127.0.0.1:" << port << "/metrics" << std::endl;
+		return true;
+	}
+
+	void stop() {
+		if (!running) { return; }
+		running = false;
+		thread.join();
+		closesocket(listener);
+		listener = INVALID_SOCKET;
+		WSACleanup();
+	}
+
+private:
+	void serve() {
+		while (running) {
+			fd_set readable;
+			FD_ZERO(&readable);
+			FD_SET(listener, &readable);
+			timeval timeout = { 0, 200000 };
+			if (select(0, &readable, nullptr, nullptr, &timeout) <= 0) { continue; }
+			SOCKET client = accept(listener, nullptr, nullptr);
+			if (client == INVALID_SOCKET) { continue; }
+			// A client that connects and doesn't send or read (a port probe) must not hold up the thread and stop()
+			DWORD timeoutMs = clientTimeoutMs;
+			setsockopt(client, SOL_SOCKET, SO_RCVTIMEO, (const char*)&timeoutMs, sizeof(timeoutMs));
+			setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, (const char*)&timeoutMs, sizeof(timeoutMs));
+			// the request itself doesn't matter, there's one document
+			char request[1024];
+			if (recv(client, request, sizeof(request), 0) > 0) {
+				std::string body = registry.text();
+				std::string response = "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: "
+					+ std::to_string(body.size()) + "\r\nConnection: close\r\n\r\n" + body;
+				for (size_t sent = 0; sent < response.size();) {
+					int n = send(client, response.data() + sent, (int)(response.size() - sent), 0);
+					if (n <= 0) { break; }
+					sent += n;
+				}
+				shutdown(client, SD_SEND);
+			}
+			closesocket(client);
+		}
+	}
+};
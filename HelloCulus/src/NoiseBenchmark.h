@@ -0,0 +1,133 @@
+#pragma once
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <Extras/OVR_Math.h>
+
+#include "NoiseLibrary.h"
+#include "QualitySweep.h"
+#include "ShaderSource.h"
+
+// Offscreen comparison of texture noise against ALU noise. First per noise kind, with a kernel evaluating it
+// EVALUATIONS times per pixel. Then on the given shader, built with and without ALU_NOISE, if it has both variants.
+const static char* noiseKernelSource = R"GLSL(#version 410
+out vec4 fragColor;
+uniform float time = 0.0;
+
+float aluHash(vec3 p)
+{
+    return fract(sin(dot(p, vec3(12.9898, 78.233, 37.719))) * 43758.5453);
+}
+
+float aluValueNoise(vec3 p)
+{
+    vec3 i = floor(p);
+    vec3 f = fract(p);
+    f = f * f * (3.0 - 2.0 * f);
+    return mix(mix(mix(aluHash(i), aluHash(i + vec3(1, 0, 0)), f.x),
+                   mix(aluHash(i + vec3(0, 1, 0)), aluHash(i + vec3(1, 1, 0)), f.x), f.y),
+               mix(mix(aluHash(i + vec3(0, 0, 1)), aluHash(i + vec3(1, 0, 1)), f.x),
+                   mix(aluHash(i + vec3(0, 1, 1)), aluHash(i + vec3(1, 1, 1)), f.x), f.y), f.z);
+}
+
+vec3 aluGradient(vec3 i)
+{
+    return normalize(vec3(aluHash(i), aluHash(i + 17.0), aluHash(i + 43.0)) * 2.0 - 1.0);
+}
+
+float aluPerlinNoise(vec3 p)
+{
+    vec3 i = floor(p);
+    vec3 f = fract(p);
+    vec3 u = f * f * f * (f * (f * 6.0 - 15.0) + 10.0);
+    float n = 0.0;
+    for (int c = 0; c < 8; c++)
+    {
+        vec3 o = vec3(c & 1, (c >> 1) & 1, c >> 2);
+        vec3 w = mix(1.0 - u, u, o);
+        n += dot(aluGradient(i + o), f - o) * w.x * w.y * w.z;
+    }
+    return n;
+}
+
+void main()
+{
+    vec3 p = vec3(gl_FragCoord.xy * 0.05, time);
+    float sum = 0.0;
+    for (int i = 0; i < EVALUATIONS; i++)
+    {
+        // depends on the previous result, so evaluations can't be hoisted or merged
+        p += vec3(0.37, 0.71, 1.13) + sum * 1e-3;
+#if KERNEL == 0
+#ifdef ALU_NOISE
+        sum += aluHash(p);
+#else
+        sum += hashTex(ivec3(floor(p * 16.0))).x;
+#endif
+#elif KERNEL == 1
+#ifdef ALU_NOISE
+        sum += aluValueNoise(p);
+#else
+        sum += valueNoiseTex(p);
+#endif
+#else
+#ifdef ALU_NOISE
+        sum += aluPerlinNoise(p);
+#else
+        sum += perlinNoiseTex(p);
+#endif
+#endif
+    }
+    fragColor = vec4(vec3(sum / float(EVALUATIONS)), 1.0);
+}
+)GLSL";
+
+struct NoiseBenchmark {
+	int evaluations = 64;
+	QualitySweep renderer; // offscreen target and GPU timing
+
+	NoiseBenchmark(OVR::Sizei size, int timedFrames, const NoiseLibrary* noise) :
+		renderer(size, timedFrames) {
+		renderer.noise = noise;
+	}
+
+	double measure(const ShaderSource& source, const ShaderDefines& defines, std::vector<unsigned char>& pixels) {
+		GLuint programId = linkFragmentProgram(source.build(defines));
+		if (!programId) { return -1.0; }
+		double ms = renderer.render(programId, pixels);
+		glDeleteProgram(programId);
+		return ms;
+	}
+
+	int run(const std::string& filepath) {
+		ShaderSource kernel;
+		kernel.parse(noiseKernelSource);
+		const char* kinds[3] = { "hash", "value noise", "Perlin noise" };
+		std::vector<unsigned char> pixels;
+		std::cout << std::fixed << std::setprecision(3) << evaluations << " evaluations per pixel:" << std::endl;
+		for (int k = 0; k < 3; k++) {
+			ShaderDefines defines = { { "KERNEL", std::to_string(k) }, { "EVALUATIONS", std::to_string(evaluations) } };
+			double textureMs = measure(kernel, defines, pixels);
+			defines.push_back({ "ALU_NOISE", "1" });
+			double aluMs = measure(kernel, defines, pixels);
+			std::cout << "  " << std::setw(12) << kinds[k] << ": texture " << textureMs << " ms, ALU " << aluMs << " ms" << std::endl;
+		}
+
+		ShaderSource source;
+		if (!source.load(filepath)) { return EXIT_FAILURE; }
+		if (source.body.find("ALU_NOISE") == std::string::npos) {
+			std::cout << filepath << " has no ALU_NOISE variant to compare" << std::endl;
+			return EXIT_SUCCESS;
+		}
+		std::vector<unsigned char> aluPixels;
+		double textureMs = measure(source, {}, pixels);
+		double aluMs = measure(source, { { "ALU_NOISE", "1" } }, aluPixels);
+		std::cout << filepath << ": texture noise " << textureMs << " ms, ALU noise " << aluMs << " ms, PSNR "
+			<< QualitySweep::psnr(aluPixels, pixels) << " dB" << std::endl;
+		return EXIT_SUCCESS;
+	}
+};
@@ -0,0 +1,240 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "GlState.h"
+
+// Tileable noise textures bound to fixed units for every shader, so that shaders can fetch noise instead of
+// computing hashes and lattice noise per sample. The prelude wraps them as hashTex(), valueNoiseTex(),
+// perlinNoiseTex() and blueNoiseTex(). Generated with fixed seeds on first start and cached on disk, since blue noise
+// takes a moment to generate.
+struct NoiseLibrary {
+	static const int firstTextureUnit = 8; // white, value, Perlin and blue noise on 8 to 11
+	static const int whiteSize = 256;      // RGBA8, four independent uniform values per texel
+	static const int valueSize = 32;       // R8 lattice values, interpolated by the sampler
+	static const int perlinSize = 64;      // R16F gradient noise, perlinCells lattice cells per repeat
+	static const int perlinCells = 8;
+	static const int blueSize = 64;        // R8 ranks of a void-and-cluster pattern
+	static const uint32_t cacheVersion = 1;
+	std::vector<uint8_t> white;
+	std::vector<uint8_t> value;
+	std::vector<float> perlin;
+	std::vector<uint8_t> blue;
+	GLuint textureIds[4] = { 0, 0, 0, 0 };
+
+	explicit NoiseLibrary(const std::string& cachePath) {
+		auto begin = std::chrono::steady_clock::now();
+		bool cached = load(cachePath);
+		if (!cached) {
+			generate();
+			save(cachePath);
+		}
+		upload();
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+		std::cout << "Noise textures " << (cached ? "loaded from " : "generated into ") << cachePath << " in " << ms << " ms" << std::endl;
+	}
+
+	~NoiseLibrary() {
+		glDeleteTextures(4, textureIds);
+	}
+
+	// Binds the textures. They stay bound, nothing else uses these units.
+	void bind() const {
+		for (int i = 0; i < 4; i++) {
+			glState().bindTexture(firstTextureUnit + i, textureIds[i]);
+		}
+	}
+
+	void setUniforms(GLuint program) const {
+		const char* names[4] = { "noiseWhite", "noiseValue", "noisePerlin", "noiseBlue" };
+		for (int i = 0; i < 4; i++) { glProgramUniform1i(program, glGetUniformLocation(program, names[i]), firstTextureUnit + i); }
+	}
+
+private:
+	void generate() {
+		std::mt19937 rng(1234);
+		white.resize(whiteSize * whiteSize * 4);
+		for (uint8_t& v : white) { v = (uint8_t)(rng() & 0xff); }
+		value.resize(valueSize * valueSize * valueSize);
+		for (uint8_t& v : value) { v = (uint8_t)(rng() & 0xff); }
+		generatePerlin(rng);
+		generateBlue(rng);
+	}
+
+	// Gradient noise sampled perlinSize / perlinCells times per lattice cell, gradients repeat every perlinCells cells
+	void generatePerlin(std::mt19937& rng) {
+		const int n = perlinCells;
+		std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+		std::vector<float> gradients(n * n * n * 3);
+		for (int i = 0; i < n * n * n; i++) {
+			float g[3], len;
+			do {
+				for (int k = 0; k < 3; k++) { g[k] = unit(rng); }
+				len = std::sqrt(g[0] * g[0] + g[1] * g[1] + g[2] * g[2]);
+			} while (len > 1.0f || len < 1e-3f);
+			for (int k = 0; k < 3; k++) { gradients[i * 3 + k] = g[k] / len; }
+		}
+		auto fade = [](float t) { return t * t * t * (t * (t * 6.0f - 15.0f) + 10.0f); };
+		perlin.resize(perlinSize * perlinSize * perlinSize);
+		const float texelsPerCell = (float)perlinSize / n;
+		for (int z = 0; z < perlinSize; z++) {
+			for (int y = 0; y < perlinSize; y++) {
+				for (int x = 0; x < perlinSize; x++) {
+					float p[3] = { x / texelsPerCell, y / texelsPerCell, z / texelsPerCell };
+					int c[3];
+					float f[3];
+					for (int k = 0; k < 3; k++) {
+						c[k] = (int)std::floor(p[k]);
+						f[k] = p[k] - c[k];
+					}
+					float sum = 0.0f;
+					for (int corner = 0; corner < 8; corner++) {
+						int o[3] = { corner & 1, (corner >> 1) & 1, corner >> 2 };
+						int gi = (((c[2] + o[2]) % n) * n + (c[1] + o[1]) % n) * n + (c[0] + o[0]) % n;
+						float dot = 0.0f, weight = 1.0f;
+						for (int k = 0; k < 3; k++) {
+							dot += gradients[gi * 3 + k] * (f[k] - o[k]);
+							weight *= o[k] ? fade(f[k]) : 1.0f - fade(f[k]);
+						}
+						sum += dot * weight;
+					}
+					perlin[(z * perlinSize + y) * perlinSize + x] = sum;
+				}
+			}
+		}
+	}
+
+	// Void and cluster (Ulichney 1993) on a torus, with Gaussian energies updated incrementally
+	void generateBlue(std::mt19937& rng) {
+		const int n = blueSize * blueSize;
+		const float sigma = 1.5f;
+		std::vector<float> kernel(n);
+		for (int y = 0; y < blueSize; y++) {
+			for (int x = 0; x < blueSize; x++) {
+				int dx = std::min(x, blueSize - x);
+				int dy = std::min(y, blueSize - y);
+				kernel[y * blueSize + x] = std::exp(-(dx * dx + dy * dy) / (2.0f * sigma * sigma));
+			}
+		}
+		std::vector<uint8_t> pattern(n, 0);
+		std::vector<float> energy(n, 0.0f);
+		auto toggle = [&](int i, bool on) {
+			pattern[i] = on;
+			int ix = i % blueSize, iy = i / blueSize;
+			float sign = on ? 1.0f : -1.0f;
+			for (int y = 0; y < blueSize; y++) {
+				for (int x = 0; x < blueSize; x++) {
+					int k = ((y - iy + blueSize) % blueSize) * blueSize + (x - ix + blueSize) % blueSize;
+					energy[y * blueSize + x] += sign * kernel[k];
+				}
+			}
+		};
+		// tightest cluster: the set pixel with the highest energy, largest void: the empty one with the lowest
+		auto extreme = [&](bool set) {
+			int best = -1;
+			for (int i = 0; i < n; i++) {
+				if (pattern[i] != set) { continue; }
+				if (best < 0 || (set ? energy[i] > energy[best] : energy[i] < energy[best])) { best = i; }
+			}
+			return best;
+		};
+
+		// initial pattern: random tenth of the pixels, relaxed until the tightest cluster is the largest void
+		const int initial = n / 10;
+		std::vector<int> order(n);
+		for (int i = 0; i < n; i++) { order[i] = i; }
+		std::shuffle(order.begin(), order.end(), rng);
+		for (int i = 0; i < initial; i++) { toggle(order[i], true); }
+		for (;;) {
+			int cluster = extreme(true);
+			toggle(cluster, false);
+			int gap = extreme(false);
+			if (gap == cluster) { toggle(cluster, true); break; }
+			toggle(gap, true);
+		}
+
+		std::vector<int> rank(n, 0);
+		std::vector<uint8_t> prototype = pattern;
+		std::vector<float> prototypeEnergy = energy;
+		// ranks below the initial count: remove tightest clusters
+		for (int r = initial - 1; r >= 0; r--) {
+			int cluster = extreme(true);
+			rank[cluster] = r;
+			toggle(cluster, false);
+		}
+		// ranks above: fill largest voids
+		pattern = prototype;
+		energy = prototypeEnergy;
+		for (int r = initial; r < n; r++) {
+			int gap = extreme(false);
+			rank[gap] = r;
+			toggle(gap, true);
+		}
+		blue.resize(n);
+		for (int i = 0; i < n; i++) { blue[i] = (uint8_t)(rank[i] * 256 / n); }
+	}
+
+	bool load(const std::string& path) {
+		std::ifstream in(path, std::ios::binary);
+		if (!in) { return false; }
+		uint32_t version = 0;
+		in.read((char*)&version, sizeof(version));
+		if (version != cacheVersion) { return false; }
+		white.resize(whiteSize * whiteSize * 4);
+		value.resize(valueSize * valueSize * valueSize);
+		perlin.resize(perlinSize * perlinSize * perlinSize);
+		blue.resize(blueSize * blueSize);
+		in.read((char*)white.data(), white.size());
+		in.read((char*)value.data(), value.size());
+		in.read((char*)perlin.data(), perlin.size() * sizeof(float));
+		in.read((char*)blue.data(), blue.size());
+		return (bool)in;
+	}
+
+	void save(const std::string& path) const {
+		std::ofstream out(path, std::ios::binary);
+		if (!out) { return; } // regenerated next time
+		out.write((const char*)&cacheVersion, sizeof(cacheVersion));
+		out.write((const char*)white.data(), white.size());
+		out.write((const char*)value.data(), value.size());
+		out.write((const char*)perlin.data(), perlin.size() * sizeof(float));
+		out.write((const char*)blue.data(), blue.size());
+	}
+
+	void upload() {
+		glGenTextures(4, textureIds);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		glBindTexture(GL_TEXTURE_2D, textureIds[0]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, whiteSize, whiteSize, 0, GL_RGBA, GL_UNSIGNED_BYTE, white.data());
+		setSampling(GL_TEXTURE_2D, GL_NEAREST);
+		glBindTexture(GL_TEXTURE_3D, textureIds[1]);
+		glTexImage3D(GL_TEXTURE_3D, 0, GL_R8, valueSize, valueSize, valueSize, 0, GL_RED, GL_UNSIGNED_BYTE, value.data());
+		setSampling(GL_TEXTURE_3D, GL_LINEAR);
+		glBindTexture(GL_TEXTURE_3D, textureIds[2]);
+		glTexImage3D(GL_TEXTURE_3D, 0, GL_R16F, perlinSize, perlinSize, perlinSize, 0, GL_RED, GL_FLOAT, perlin.data());
+		setSampling(GL_TEXTURE_3D, GL_LINEAR);
+		glBindTexture(GL_TEXTURE_2D, textureIds[3]);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R8, blueSize, blueSize, 0, GL_RED, GL_UNSIGNED_BYTE, blue.data());
+		setSampling(GL_TEXTURE_2D, GL_NEAREST);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glBindTexture(GL_TEXTURE_3D, 0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	static void setSampling(GLenum target, GLint filter) {
+		glTexParameteri(target, GL_TEXTURE_MIN_FILTER, filter);
+		glTexParameteri(target, GL_TEXTURE_MAG_FILTER, filter);
+		glTexParameteri(target, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(target, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glTexParameteri(target, GL_TEXTURE_WRAP_R, GL_REPEAT);
+	}
+};
@@ -1,5 +1,6 @@
 #pragma once
 #include "assert.h"
+#include <chrono>
 #include <iostream>
 
 #include <glad/glad.h>
@@ -9,10 +10,23 @@
 #include <OVR_CAPI_GL.h>
 #include <Extras/OVR_Math.h>
 
+#include "GlDebug.h"
+#include "GlState.h"
+
+// Desktop window updates. The headset loop doesn't wait for the window: with a swap interval of 0 a swap doesn't block,
+// and Limited presents at rateHz at most, OnDemand only when requested, Off never.
+enum class MirrorMode { EveryFrame, Limited, OnDemand, Off };
+
 struct OculusMirrorBuffer {
 	ovrMirrorTexture mirrorTexture;
 	GLuint fboId;
 	OVR::Sizei texSize;
+	MirrorMode mode = MirrorMode::Limited;
+	double rateHz = 30.0;
+	bool requested = false;
+	std::chrono::steady_clock::time_point lastPresent;
+	double smoothedMs = 0.0; // CPU time of blit and swap per headset frame, 0 for frames it's skipped
+	double lastMs = 0.0;     // of the last present
 
 	OculusMirrorBuffer(const ovrSession& session, OVR::Sizei size) :
 		mirrorTexture(nullptr),
@@ -28,21 +42,56 @@ struct OculusMirrorBuffer {
 		if (!OVR_SUCCESS(result)) { std::cout << "Unable to create mirror texture" << std::endl; exit(0); }
 		GLuint texId;
 		ovr_GetMirrorTextureBufferGL(session, mirrorTexture, &texId);
-		glGenFramebuffers(1, &fboId);
-		glBindFramebuffer(GL_READ_FRAMEBUFFER, fboId);
-		glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texId, 0);
-		glFramebufferRenderbuffer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, 0);
-		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+		glCreateFramebuffers(1, &fboId);
+		glNamedFramebufferTexture(fboId, GL_COLOR_ATTACHMENT0, texId, 0);
+	}
+
+	const char* name() const {
+		switch (mode) {
+		case MirrorMode::EveryFrame: return "every frame";
+		case MirrorMode::OnDemand: return "on demand";
+		case MirrorMode::Off: return "off";
+		default: return "limited";
+		}
+	}
+
+	void cycleMode() {
+		mode = mode == MirrorMode::EveryFrame ? MirrorMode::Limited : mode == MirrorMode::Limited ? MirrorMode::OnDemand
+			: mode == MirrorMode::OnDemand ? MirrorMode::Off : MirrorMode::EveryFrame;
 	}
 
-	void render() {
-		glBindFramebuffer(GL_READ_FRAMEBUFFER, fboId);
-		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
-		glBlitFramebuffer(0, texSize.h, texSize.w, 0,
-			0, 0, texSize.w, texSize.h,
-			GL_COLOR_BUFFER_BIT, GL_NEAREST);
-		glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
-		glutSwapBuffers();
+	// Presents the next headset frame in OnDemand mode
+	void request() {
+		requested = true;
+	}
+
+	bool due(std::chrono::steady_clock::time_point now) const {
+		switch (mode) {
+		case MirrorMode::EveryFrame: return true;
+		case MirrorMode::Limited: return rateHz > 0.0 && std::chrono::duration<double>(now - lastPresent).count() >= 1.0 / rateHz;
+		case MirrorMode::OnDemand: return requested;
+		default: return false;
+		}
+	}
+
+	// Returns whether the window was updated
+	bool render() {
+		auto begin = std::chrono::steady_clock::now();
+		double ms = 0.0;
+		const bool present = due(begin);
+		if (present) {
+			GlDebugGroup group("mirror");
+			glBlitNamedFramebuffer(fboId, 0, 0, texSize.h, texSize.w, 0,
+				0, 0, texSize.w, texSize.h,
+				GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			glutSwapBuffers();
+			lastPresent = begin;
+			requested = false;
+			ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+			lastMs = ms;
+		}
+		smoothedMs = smoothedMs * 0.95 + ms * 0.05;
+		return present;
 	}
 };
 
@@ -91,12 +140,11 @@ struct OculusTextureBuffer
 				{
 					GLuint chainTexId;
 					ovr_GetTextureSwapChainBufferGL(Session, ColorTextureChain, i, &chainTexId);
-					glBindTexture(GL_TEXTURE_2D, chainTexId);
 
-					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+					glTextureParameteri(chainTexId, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+					glTextureParameteri(chainTexId, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+					glTextureParameteri(chainTexId, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+					glTextureParameteri(chainTexId, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 				}
 			}
 		}
@@ -115,17 +163,16 @@ struct OculusTextureBuffer
 				{
 					GLuint chainTexId;
 					ovr_GetTextureSwapChainBufferGL(Session, DepthTextureChain, i, &chainTexId);
-					glBindTexture(GL_TEXTURE_2D, chainTexId);
 
-					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-					glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+					glTextureParameteri(chainTexId, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+					glTextureParameteri(chainTexId, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+					glTextureParameteri(chainTexId, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+					glTextureParameteri(chainTexId, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
 				}
 			}
 		}
 
-		glGenFramebuffers(1, &fboId);
+		glCreateFramebuffers(1, &fboId);
 	}
 
 	~OculusTextureBuffer()
@@ -167,20 +214,19 @@ struct OculusTextureBuffer
 			ovr_GetTextureSwapChainBufferGL(Session, DepthTextureChain, curIndex, &curDepthTexId);
 		}
 
-		glBindFramebuffer(GL_FRAMEBUFFER, fboId);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, curColorTexId, 0);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, curDepthTexId, 0);
+		glNamedFramebufferTexture(fboId, GL_COLOR_ATTACHMENT0, curColorTexId, 0);
+		glNamedFramebufferTexture(fboId, GL_DEPTH_ATTACHMENT, curDepthTexId, 0);
+		glState().bindFramebuffer(fboId);
 
-		glViewport(0, 0, texSize.w, texSize.h);
+		glState().viewport(0, 0, texSize.w, texSize.h);
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-		glEnable(GL_FRAMEBUFFER_SRGB);
+		glState().enable(GL_FRAMEBUFFER_SRGB);
 	}
 
 	void UnsetRenderSurface()
 	{
-		glBindFramebuffer(GL_FRAMEBUFFER, fboId);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, 0, 0);
+		glNamedFramebufferTexture(fboId, GL_COLOR_ATTACHMENT0, 0, 0);
+		glNamedFramebufferTexture(fboId, GL_DEPTH_ATTACHMENT, 0, 0);
 	}
 
 	void Commit()
@@ -0,0 +1,142 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+// CPU timeline of the frame loop. ProfileZone records its scope's begin and end timestamp counter values under a
+// static name into a buffer of the calling thread, no locks and no allocation per zone. Each thread's buffer is a
+// ring of its last events. dump() writes the zones of the last frames as a Chrome trace (chrome://tracing, Perfetto),
+// nested zones show as a stack per thread. Names must outlive the profiler, string literals.
+struct ProfileEvent {
+	const char* name;
+	uint64_t begin;
+	uint64_t end;
+};
+
+struct ProfileThread {
+	static const size_t capacity = 1 << 16;
+	std::vector<ProfileEvent> events;
+	std::atomic<uint64_t> count{ 0 }; // events ever recorded, the newest is at (count - 1) % capacity
+	int id;
+	std::string name;
+
+	ProfileThread(int id, const std::string& name) :
+		events(capacity),
+		id(id),
+		name(name) {
+	}
+
+	// Only called by the owning thread
+	void record(const char* zone, uint64_t begin, uint64_t end) {
+		const uint64_t n = count.load(std::memory_order_relaxed);
+		events[n % capacity] = { zone, begin, end };
+		count.store(n + 1, std::memory_order_release);
+	}
+};
+
+struct Profiler {
+	static const size_t frameCapacity = 1024;
+	std::mutex mutex; // thread registration and dumps
+	std::vector<std::unique_ptr<ProfileThread>> threads;
+	uint64_t frameStarts[frameCapacity] = {};
+	uint64_t frames = 0;
+	const uint64_t tscStart = now();
+	const std::chrono::steady_clock::time_point clockStart = std::chrono::steady_clock::now();
+
+	static uint64_t now() { return __rdtsc(); }
+
+	// The calling thread's buffer, created on its first zone
+	ProfileThread& thread() {
+		thread_local ProfileThread* current = nullptr;
+		if (!current) {
+			std::lock_guard<std::mutex> lock(mutex);
+			threads.emplace_back(new ProfileThread((int)threads.size(), "thread " + std::to_string(threads.size())));
+			current = threads.back().get();
+		}
+		return *current;
+	}
+
+	// Name of the calling thread in traces, before its first zone
+	void nameThread(const std::string& name) {
+		ProfileThread& t = thread();
+		std::lock_guard<std::mutex> lock(mutex);
+		t.name = name;
+	}
+
+	// At the start of every frame, on the render thread
+	void frame() {
+		frameStarts[frames % frameCapacity] = now();
+		frames++;
+	}
+
+	// Zones of threads other than the dumping one are read while they may record, events being overwritten at the
+	// same time would come out garbled. With rings this large that's only the case for the oldest ones, dropped here.
+	bool dump(const std::string& path, int lastFrames) {
+		const uint64_t tscEnd = now();
+		const double clockUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - clockStart).count();
+		const double ticksPerUs = clockUs > 0.0 ? (tscEnd - tscStart) / clockUs : 1.0;
+		// early in the run that includes startup
+		const uint64_t n = std::min<uint64_t>(std::min<uint64_t>((uint64_t)lastFrames, frames), frameCapacity);
+		const uint64_t windowStart = n == frames ? tscStart : frameStarts[(frames - n) % frameCapacity];
+
+		std::ofstream out(path);
+		if (!out) { std::cout << "Can't write " << path << std::endl; return false; }
+		out << std::fixed << std::setprecision(3) << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+		size_t written = 0;
+		std::lock_guard<std::mutex> lock(mutex);
+		for (const auto& t : threads) {
+			out << (written++ ? ",\n" : "") << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << t->id
+				<< ",\"args\":{\"name\":\"" << t->name << "\"}}";
+			const uint64_t count = t->count.load(std::memory_order_acquire);
+			const uint64_t first = count > ProfileThread::capacity / 2 ? count - ProfileThread::capacity / 2 : 0;
+			for (uint64_t i = first; i < count; i++) {
+				const ProfileEvent e = t->events[i % ProfileThread::capacity];
+				if (e.begin < windowStart || e.end < e.begin) { continue; }
+				out << ",\n{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << t->id
+					<< ",\"ts\":" << (e.begin - tscStart) / ticksPerUs << ",\"dur\":" << (e.end - e.begin) / ticksPerUs << "}";
+				written++;
+			}
+		}
+		out << "\n]}\n";
+		std::cout << std::endl << "Trace of the last " << n << " frames written to " << path << std::endl;
+		return true;
+	}
+};
+
+inline Profiler& profiler() {
+	static Profiler p;
+	return p;
+}
+
+struct ProfileZone {
+	ProfileThread& thread;
+	const char* name;
+	uint64_t begin;
+
+	explicit ProfileZone(const char* name) :
+		thread(profiler().thread()),
+		name(name),
+		begin(Profiler::now()) {
+	}
+
+	~ProfileZone() {
+		thread.record(name, begin, Profiler::now());
+	}
+
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+};
@@ -0,0 +1,243 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <Extras/OVR_Math.h>
+
+#include "FullscreenTriangle.h"
+#include "GlState.h"
+#include "NoiseLibrary.h"
+#include "ShaderSource.h"
+
+// Offscreen quality-vs-cost exploration of a shader's "// @sweep NAME v1 v2 ..." knobs.
+// Values are listed from cheapest to best quality, the reference image uses the last value of every knob.
+// Every combination is timed on the GPU and compared against the reference with PSNR and SSIM.
+// Results go to "<shader>.sweep.csv" (for plotting) and the Pareto-optimal settings are printed.
+struct SweepKnob {
+	std::string name;
+	std::vector<std::string> values;
+};
+
+struct SweepResult {
+	ShaderDefines defines;
+	double gpuMs = 0.0;
+	double psnr = 0.0;
+	double ssim = 0.0;
+	bool pareto = false;
+};
+
+struct QualitySweep {
+	ShaderSource source;
+	std::vector<SweepKnob> knobs;
+	OVR::Sizei size;
+	int timedFrames;
+	GLuint fboId = 0;
+	GLuint colorTexId = 0;
+	GLuint queryId = 0;
+	const NoiseLibrary* noise = nullptr; // bound by the caller, for shaders that fetch noise
+
+	QualitySweep(OVR::Sizei size, int timedFrames) :
+		size(size),
+		timedFrames(timedFrames) {
+		glGenTextures(1, &colorTexId);
+		glBindTexture(GL_TEXTURE_2D, colorTexId);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size.w, size.h, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glGenFramebuffers(1, &fboId);
+		glState().bindFramebuffer(fboId);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, colorTexId, 0);
+		glState().bindFramebuffer(0);
+		glGenQueries(1, &queryId);
+	}
+
+	~QualitySweep() {
+		glDeleteQueries(1, &queryId);
+		glDeleteFramebuffers(1, &fboId);
+		glDeleteTextures(1, &colorTexId);
+	}
+
+	bool load(const std::string& filepath) {
+		if (!source.load(filepath)) { return false; }
+		for (const ShaderDirective& d : source.directives) {
+			if (d.name != "sweep" || d.args.size() < 2) { continue; }
+			SweepKnob knob;
+			knob.name = d.args[0];
+			knob.values.assign(d.args.begin() + 1, d.args.end());
+			knobs.push_back(knob);
+		}
+		return true;
+	}
+
+	GLuint buildProgram(const ShaderDefines& defines) {
+		return linkFragmentProgram(source.build(defines));
+	}
+
+	void draw(GLuint programId) {
+		fullscreen().draw(programId);
+	}
+
+	// Renders one setting, returns average GPU time in ms and leaves the RGB image in pixels.
+	double render(GLuint programId, std::vector<unsigned char>& pixels) {
+		glState().bindFramebuffer(fboId);
+		glState().viewport(0, 0, size.w, size.h);
+		glState().useProgram(programId);
+		// Fixed camera at the shader's default ro looking down -Z with a 90 degree horizontal FOV
+		const float tanX = 1.0f;
+		const float tanY = tanX * size.h / size.w;
+		glProgramUniform2f(programId, glGetUniformLocation(programId, "resolution"), (float)size.w, (float)size.h);
+		glProgramUniform3f(programId, glGetUniformLocation(programId, "rayCorner"), -tanX, -tanY, -1.0f);
+		glProgramUniform3f(programId, glGetUniformLocation(programId, "rayDx"), 2.0f * tanX / size.w, 0.0f, 0.0f);
+		glProgramUniform3f(programId, glGetUniformLocation(programId, "rayDy"), 0.0f, 2.0f * tanY / size.h, 0.0f);
+		if (noise) { noise->setUniforms(programId); }
+		// warm-up so that lazy driver work doesn't end up in the timing
+		draw(programId);
+		glFinish();
+
+		GLuint64 totalNs = 0;
+		for (int i = 0; i < timedFrames; i++) {
+			glBeginQuery(GL_TIME_ELAPSED, queryId);
+			draw(programId);
+			glEndQuery(GL_TIME_ELAPSED);
+			GLuint64 ns = 0;
+			glGetQueryObjectui64v(queryId, GL_QUERY_RESULT, &ns);
+			totalNs += ns;
+		}
+
+		pixels.resize(size.w * size.h * 3);
+		glPixelStorei(GL_PACK_ALIGNMENT, 1);
+		glReadPixels(0, 0, size.w, size.h, GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+		glState().bindFramebuffer(0);
+		return totalNs / 1e6 / timedFrames;
+	}
+
+	static double psnr(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b) {
+		double mse = 0.0;
+		for (size_t i = 0; i < a.size(); i++) {
+			double d = double(a[i]) - double(b[i]);
+			mse += d * d;
+		}
+		mse /= a.size();
+		if (mse == 0.0) { return 100.0; }
+		return 10.0 * std::log10(255.0 * 255.0 / mse);
+	}
+
+	// Mean SSIM of luma over non-overlapping 8x8 windows.
+	double ssim(const std::vector<unsigned char>& a, const std::vector<unsigned char>& b) const {
+		const int win = 8;
+		const double c1 = (0.01 * 255) * (0.01 * 255);
+		const double c2 = (0.03 * 255) * (0.03 * 255);
+		auto luma = [](const std::vector<unsigned char>& img, int i) {
+			return 0.299 * img[i * 3] + 0.587 * img[i * 3 + 1] + 0.114 * img[i * 3 + 2];
+		};
+		double total = 0.0;
+		int windows = 0;
+		for (int y0 = 0; y0 + win <= size.h; y0 += win) {
+			for (int x0 = 0; x0 + win <= size.w; x0 += win) {
+				double ma = 0, mb = 0, va = 0, vb = 0, cov = 0;
+				for (int y = y0; y < y0 + win; y++) {
+					for (int x = x0; x < x0 + win; x++) {
+						double la = luma(a, y * size.w + x);
+						double lb = luma(b, y * size.w + x);
+						ma += la; mb += lb;
+						va += la * la; vb += lb * lb; cov += la * lb;
+					}
+				}
+				const double n = win * win;
+				ma /= n; mb /= n;
+				va = va / n - ma * ma;
+				vb = vb / n - mb * mb;
+				cov = cov / n - ma * mb;
+				total += ((2 * ma * mb + c1) * (2 * cov + c2)) / ((ma * ma + mb * mb + c1) * (va + vb + c2));
+				windows++;
+			}
+		}
+		return windows ? total / windows : 1.0;
+	}
+
+	static void markPareto(std::vector<SweepResult>& results) {
+		std::vector<SweepResult*> sorted;
+		for (SweepResult& r : results) { sorted.push_back(&r); }
+		std::sort(sorted.begin(), sorted.end(), [](const SweepResult* a, const SweepResult* b) {
+			return a->gpuMs != b->gpuMs ? a->gpuMs < b->gpuMs : a->ssim > b->ssim;
+		});
+		double bestSsim = -1.0;
+		for (SweepResult* r : sorted) {
+			if (r->ssim > bestSsim) {
+				r->pareto = true;
+				bestSsim = r->ssim;
+			}
+		}
+	}
+
+	static std::string describe(const ShaderDefines& defines) {
+		std::string s;
+		for (const auto& def : defines) { s += (s.empty() ? "" : " ") + def.first + "=" + def.second; }
+		return s;
+	}
+
+	int run(const std::string& filepath) {
+		if (!load(filepath)) { return EXIT_FAILURE; }
+		if (knobs.empty()) { std::cout << "No // @sweep directives in " << filepath << std::endl; return EXIT_FAILURE; }
+
+		ShaderDefines referenceDefines;
+		for (const SweepKnob& knob : knobs) { referenceDefines.push_back({ knob.name, knob.values.back() }); }
+		GLuint referenceProg = buildProgram(referenceDefines);
+		if (!referenceProg) { return EXIT_FAILURE; }
+		std::vector<unsigned char> reference, pixels;
+		double referenceMs = render(referenceProg, reference);
+		glDeleteProgram(referenceProg);
+		std::cout << "Reference (" << describe(referenceDefines) << "): " << referenceMs << " ms" << std::endl;
+
+		// odometer over all knob value combinations
+		std::vector<SweepResult> results;
+		std::vector<size_t> counter(knobs.size(), 0);
+		while (true) {
+			SweepResult r;
+			for (size_t k = 0; k < knobs.size(); k++) { r.defines.push_back({ knobs[k].name, knobs[k].values[counter[k]] }); }
+			GLuint programId = buildProgram(r.defines);
+			if (programId) {
+				r.gpuMs = render(programId, pixels);
+				r.psnr = psnr(reference, pixels);
+				r.ssim = ssim(reference, pixels);
+				glDeleteProgram(programId);
+				results.push_back(r);
+				std::cout << "  " << describe(r.defines) << ": " << r.gpuMs << " ms, PSNR " << r.psnr << " dB, SSIM " << r.ssim << std::endl;
+			}
+
+			size_t k = 0;
+			while (k < knobs.size() && ++counter[k] == knobs[k].values.size()) { counter[k++] = 0; }
+			if (k == knobs.size()) { break; }
+		}
+		markPareto(results);
+
+		std::string csvPath = filepath + ".sweep.csv";
+		std::ofstream csv(csvPath);
+		for (const SweepKnob& knob : knobs) { csv << knob.name << ","; }
+		csv << "gpu_ms,psnr,ssim,pareto" << std::endl;
+		for (const SweepResult& r : results) {
+			for (const auto& def : r.defines) { csv << def.second << ","; }
+			csv << r.gpuMs << "," << r.psnr << "," << r.ssim << "," << r.pareto << std::endl;
+		}
+		std::cout << "Wrote " << results.size() << " settings to " << csvPath << std::endl;
+
+		std::vector<SweepResult> front;
+		std::copy_if(results.begin(), results.end(), std::back_inserter(front), [](const SweepResult& r) { return r.pareto; });
+		std::sort(front.begin(), front.end(), [](const SweepResult& a, const SweepResult& b) { return a.gpuMs < b.gpuMs; });
+		std::cout << "Pareto-optimal settings (GPU time vs SSIM):" << std::endl;
+		for (const SweepResult& r : front) {
+			std::cout << std::fixed << std::setprecision(3)
+				<< "  " << std::setw(8) << r.gpuMs << " ms  SSIM " << r.ssim << "  PSNR " << std::setw(7) << r.psnr << " dB  "
+				<< describe(r.defines) << std::endl;
+		}
+		return EXIT_SUCCESS;
+	}
+};
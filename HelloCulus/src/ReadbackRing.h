@@ -0,0 +1,76 @@
+#pragma once
+#include <functional>
+
+#include <glad/glad.h>
+
+#include <Extras/OVR_Math.h>
+
+#include "GlDebug.h"
+#include "GlState.h"
+
+// Reads a framebuffer back without stalling: each frame into the next pixel buffer object of a ring, mapped only once
+// its fence has signaled, a few frames later. When the GPU is so far behind that the whole ring is in flight the
+// frame is skipped and counted.
+struct ReadbackRing {
+	static const int ringSize = 4;
+	struct Slot {
+		GLuint pboId = 0;
+		GLsync fence = nullptr;
+	};
+	OVR::Sizei size;
+	Slot ring[ringSize];
+	int next = 0;    // slot the next readback goes to
+	int pending = 0; // slots in flight, the oldest is next - pending
+	long long started = 0;
+	long long dropped = 0; // ring full
+
+	explicit ReadbackRing(OVR::Sizei size) :
+		size(size) {
+		for (Slot& s : ring) {
+			glCreateBuffers(1, &s.pboId);
+			glNamedBufferStorage(s.pboId, frameBytes(), nullptr, GL_MAP_READ_BIT | GL_CLIENT_STORAGE_BIT);
+		}
+	}
+
+	~ReadbackRing() {
+		for (Slot& s : ring) {
+			if (s.fence) { glDeleteSync(s.fence); }
+			glDeleteBuffers(1, &s.pboId);
+		}
+	}
+
+	size_t frameBytes() const { return (size_t)size.w * size.h * 4; }
+
+	// RGBA rows of framebuffer fboId, y = 0 first. Returns false when the ring is full.
+	bool read(GLuint fboId) {
+		if (pending == ringSize) { dropped++; return false; }
+		GlDebugGroup group("readback");
+		Slot& s = ring[next];
+		glState().bindFramebuffer(fboId);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, s.pboId);
+		glReadPixels(0, 0, size.w, size.h, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+		glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+		s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		next = (next + 1) % ringSize;
+		pending++;
+		started++;
+		return true;
+	}
+
+	// Hands the finished readbacks to consume, oldest first, while mapped. With wait, all of them, finished or not.
+	void collect(const std::function<void(const unsigned char*)>& consume, bool wait = false) {
+		while (pending > 0) {
+			Slot& s = ring[(next - pending + ringSize) % ringSize];
+			GLenum status = glClientWaitSync(s.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? GL_TIMEOUT_IGNORED : 0);
+			if (status == GL_TIMEOUT_EXPIRED) { return; }
+			glDeleteSync(s.fence);
+			s.fence = nullptr;
+			pending--;
+			const unsigned char* mapped = (const unsigned char*)glMapNamedBufferRange(s.pboId, 0, frameBytes(), GL_MAP_READ_BIT);
+			if (mapped) {
+				consume(mapped);
+				glUnmapNamedBuffer(s.pboId);
+			}
+		}
+	}
+};
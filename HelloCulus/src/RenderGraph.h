@@ -0,0 +1,378 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <Extras/OVR_Math.h>
+
+#include "GlDebug.h"
+#include "GlState.h"
+#include "ShaderSource.h"
+
+// Multi-pass shaders, Shadertoy style. A shader file declares its passes with
+//   // @pass NAME [scale:S] [in:A,B.prev,...] [once]
+// and is compiled once per pass with GRAPH_PASS and PASS_<NAME> defined. Inputs are bound to iChannel0, iChannel1...
+// in the listed order, "B.prev" being B's output of the previous frame (feedback). A "once" pass only depends on its
+// inputs (no time, no camera): it is rendered again only when one of them was. The pass named Image (or else the last
+// one) renders into the eye buffer and can't be read by other passes, the others render into RGBA16F textures of
+// eye size * scale.
+// Passes whose output lives for a single frame get their texture from a pool shared by both eyes, a texture is
+// returned to the pool after its last reader ran, so passes with disjoint lifetimes alias the same memory.
+struct GraphPassInput {
+	int pass;
+	bool previous;
+};
+
+struct GraphPass {
+	std::string name;
+	float scale = 1.0f;
+	bool once = false;
+	bool feedback = false; // read as NAME.prev, keeps two textures per eye
+	std::vector<GraphPassInput> inputs;
+	GLuint program = 0;
+	int lastReader = -1; // schedule position of the last pass reading this frame's output, schedule.size() for the output pass
+
+	bool persistent() const { return once || feedback; }
+};
+
+struct GraphPassEye {
+	GLuint persistentTexId[2] = { 0, 0 };
+	int current = 0;
+	GLuint texId = 0;         // this frame's output
+	GLuint previousTexId = 0; // previous frame's output, for feedback
+	bool valid = false;
+	bool executed = false;
+};
+
+struct PooledTexture {
+	GLuint texId;
+	OVR::Sizei size;
+	bool inUse;
+};
+
+struct RenderGraph {
+	static const int maxChannels = 4;
+	OVR::Sizei eyeSize[2];
+	std::vector<GraphPass> passes;
+	std::vector<int> schedule; // offscreen passes in execution order, the output pass is not part of it
+	int outputPass = -1;
+	std::vector<GraphPassEye> eyes[2];
+	std::vector<PooledTexture> pool;
+	GLuint fboId = 0;
+
+	RenderGraph(const OVR::Sizei eyeBufferSize[2]) {
+		eyeSize[0] = eyeBufferSize[0];
+		eyeSize[1] = eyeBufferSize[1];
+		glGenFramebuffers(1, &fboId);
+	}
+
+	~RenderGraph() {
+		unload();
+		glDeleteFramebuffers(1, &fboId);
+	}
+
+	bool active() const { return outputPass >= 0; }
+
+	void unload() {
+		for (GraphPass& p : passes) { glDeleteProgram(p.program); }
+		for (int eye = 0; eye < 2; eye++) {
+			for (GraphPassEye& e : eyes[eye]) { glDeleteTextures(2, e.persistentTexId); }
+			eyes[eye].clear();
+		}
+		for (PooledTexture& t : pool) { glDeleteTextures(1, &t.texId); }
+		pool.clear();
+		passes.clear();
+		schedule.clear();
+		outputPass = -1;
+	}
+
+	int findPass(const std::string& name) const {
+		for (int i = 0; i < (int)passes.size(); i++) {
+			if (passes[i].name == name) { return i; }
+		}
+		return -1;
+	}
+
+	// Builds the passes if the shader declares any. Returns whether the graph is active.
+	bool load(const ShaderSource& source, const ShaderDefines& defines) {
+		unload();
+		std::vector<std::vector<std::string>> inputNames;
+		for (const ShaderDirective& d : source.directives) {
+			if (d.name != "pass" || d.args.empty()) { continue; }
+			GraphPass p;
+			p.name = d.args[0];
+			std::vector<std::string> names;
+			for (size_t i = 1; i < d.args.size(); i++) {
+				const std::string& arg = d.args[i];
+				if (arg == "once") { p.once = true; }
+				else if (arg.compare(0, 6, "scale:") == 0) {
+					// a malformed scale leaves the pass at full resolution
+					float scale = 0.0f;
+					if (ShaderDirective::parseNumber(arg.substr(6), scale) && scale > 0.0f) { p.scale = scale; }
+					else { std::cout << "@pass " << p.name << ": " << arg << " is not a positive scale, ignored" << std::endl; }
+				}
+				else if (arg.compare(0, 3, "in:") == 0) {
+					size_t start = 3;
+					while (start <= arg.size()) {
+						size_t comma = std::min(arg.find(',', start), arg.size());
+						if (comma > start) { names.push_back(arg.substr(start, comma - start)); }
+						start = comma + 1;
+					}
+				}
+			}
+			passes.push_back(p);
+			inputNames.push_back(names);
+		}
+		if (passes.empty()) { return false; }
+
+		outputPass = findPass("Image");
+		if (outputPass < 0) { outputPass = (int)passes.size() - 1; }
+		for (int i = 0; i < (int)passes.size(); i++) {
+			GraphPass& p = passes[i];
+			for (const std::string& name : inputNames[i]) {
+				bool previous = name.size() > 5 && name.compare(name.size() - 5, 5, ".prev") == 0;
+				int source = findPass(previous ? name.substr(0, name.size() - 5) : name);
+				if (source < 0 || source == outputPass || (int)p.inputs.size() == maxChannels) {
+					std::cout << "Render graph: ignoring input " << name << " of pass " << p.name << std::endl;
+					continue;
+				}
+				if (previous) {
+					passes[source].feedback = true;
+					if (p.once) { p.once = false; std::cout << "Render graph: pass " << p.name << " reads feedback, can't be once" << std::endl; }
+				}
+				p.inputs.push_back({ source, previous });
+			}
+		}
+		if (!buildSchedule()) {
+			std::cout << "Render graph disabled, its passes have a dependency cycle." << std::endl;
+			unload();
+			return false;
+		}
+
+		for (int i : scheduleWithOutput()) {
+			ShaderDefines passDefines = defines;
+			passDefines.push_back({ "GRAPH_PASS", "1" });
+			passDefines.push_back({ "PASS_" + passes[i].name, "1" });
+			passes[i].program = linkFragmentProgram(source.build(passDefines));
+			if (!passes[i].program) {
+				std::cout << "Render graph disabled, pass " << passes[i].name << " failed to build." << std::endl;
+				unload();
+				return false;
+			}
+		}
+		for (int eye = 0; eye < 2; eye++) {
+			eyes[eye].assign(passes.size(), GraphPassEye());
+			for (int i : schedule) {
+				if (!passes[i].persistent()) { continue; }
+				GraphPassEye& e = eyes[eye][i];
+				e.persistentTexId[0] = createTexture(passSize(eye, i));
+				if (passes[i].feedback) { e.persistentTexId[1] = createTexture(passSize(eye, i)); }
+			}
+		}
+		printSummary();
+		return true;
+	}
+
+	// Topological order of the passes the output depends on (this frame or through feedback), in declaration order
+	// where there is a choice. Returns false on a cycle among this frame's dependencies.
+	bool buildSchedule() {
+		std::vector<bool> needed(passes.size(), false);
+		std::vector<int> stack = { outputPass };
+		while (!stack.empty()) {
+			int i = stack.back();
+			stack.pop_back();
+			if (needed[i]) { continue; }
+			needed[i] = true;
+			for (const GraphPassInput& in : passes[i].inputs) { stack.push_back(in.pass); }
+		}
+		std::vector<bool> done(passes.size(), false);
+		std::vector<int> order;
+		bool progress = true;
+		while (progress) {
+			progress = false;
+			for (int i = 0; i < (int)passes.size(); i++) {
+				if (!needed[i] || done[i]) { continue; }
+				bool ready = true;
+				for (const GraphPassInput& in : passes[i].inputs) {
+					if (!in.previous && !done[in.pass]) { ready = false; }
+				}
+				if (ready) { order.push_back(i); done[i] = true; progress = true; break; }
+			}
+		}
+		for (int i = 0; i < (int)passes.size(); i++) {
+			if (needed[i] && !done[i]) { return false; }
+		}
+		schedule.clear();
+		for (int i : order) {
+			if (i != outputPass) { schedule.push_back(i); }
+		}
+		std::vector<int> withOutput = scheduleWithOutput();
+		for (int s = 0; s < (int)withOutput.size(); s++) {
+			for (const GraphPassInput& in : passes[withOutput[s]].inputs) {
+				if (!in.previous) { passes[in.pass].lastReader = std::max(passes[in.pass].lastReader, s); }
+			}
+		}
+		return true;
+	}
+
+	std::vector<int> scheduleWithOutput() const {
+		std::vector<int> order = schedule;
+		order.push_back(outputPass);
+		return order;
+	}
+
+	OVR::Sizei passSize(int eye, int pass) const {
+		float scale = pass == outputPass ? 1.0f : passes[pass].scale;
+		return OVR::Sizei(std::max(1, (int)std::ceil(eyeSize[eye].w * scale)), std::max(1, (int)std::ceil(eyeSize[eye].h * scale)));
+	}
+
+	GLuint createTexture(OVR::Sizei size) {
+		GLuint texId;
+		glGenTextures(1, &texId);
+		glBindTexture(GL_TEXTURE_2D, texId);
+		glTexStorage2D(GL_TEXTURE_2D, 1, GL_RGBA16F, size.w, size.h);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		// feedback reads it before it was ever rendered
+		GLuint framebuffer = glState().framebuffer;
+		glState().bindFramebuffer(fboId);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texId, 0);
+		glClear(GL_COLOR_BUFFER_BIT);
+		glState().bindFramebuffer(framebuffer);
+		return texId;
+	}
+
+	GLuint acquire(OVR::Sizei size) {
+		for (PooledTexture& t : pool) {
+			if (!t.inUse && t.size == size) { t.inUse = true; return t.texId; }
+		}
+		pool.push_back({ createTexture(size), size, true });
+		return pool.back().texId;
+	}
+
+	void release(GLuint texId) {
+		for (PooledTexture& t : pool) {
+			if (t.texId == texId) { t.inUse = false; }
+		}
+	}
+
+	// Transient textures needed at the peak of one eye's schedule, which is what the pool holds after the first frame.
+	void printSummary() const {
+		std::vector<std::pair<OVR::Sizei, int>> live, peak;
+		auto countOf = [](std::vector<std::pair<OVR::Sizei, int>>& counts, OVR::Sizei size) -> int& {
+			for (auto& entry : counts) {
+				if (entry.first == size) { return entry.second; }
+			}
+			counts.push_back({ size, 0 });
+			return counts.back().second;
+		};
+		int transient = 0;
+		for (int s = 0; s < (int)schedule.size(); s++) {
+			if (passes[schedule[s]].persistent()) { continue; }
+			transient++;
+			OVR::Sizei size = passSize(0, schedule[s]);
+			int& count = countOf(live, size);
+			count++;
+			int& maxCount = countOf(peak, size);
+			maxCount = std::max(maxCount, count);
+			for (int r = 0; r <= s; r++) {
+				const GraphPass& q = passes[schedule[r]];
+				if (!q.persistent() && q.lastReader == s) { countOf(live, passSize(0, schedule[r]))--; }
+			}
+		}
+		int textures = 0;
+		for (auto& entry : peak) { textures += entry.second; }
+		std::cout << "Render graph: " << schedule.size() + 1 << " passes, output " << passes[outputPass].name << ", "
+			<< transient << " transient outputs in " << textures << " pooled textures" << std::endl;
+	}
+
+	void invalidate() {
+		for (int eye = 0; eye < 2; eye++) {
+			for (GraphPassEye& e : eyes[eye]) { e.valid = false; }
+		}
+	}
+
+	void bindInputs(int eye, int pass) {
+		const GraphPass& p = passes[pass];
+		for (int c = 0; c < (int)p.inputs.size(); c++) {
+			const GraphPassInput& in = p.inputs[c];
+			const GraphPassEye& source = eyes[eye][in.pass];
+			OVR::Sizei size = passSize(eye, in.pass);
+			const std::string channel = std::to_string(c);
+			glState().bindTexture(c, in.previous ? source.previousTexId : source.texId);
+			glProgramUniform1i(p.program, glGetUniformLocation(p.program, ("iChannel" + channel).c_str()), c);
+			glProgramUniform2f(p.program, glGetUniformLocation(p.program, ("iChannelResolution[" + channel + "]").c_str()), (float)size.w, (float)size.h);
+		}
+	}
+
+	// Offscreen passes of one eye. setUniforms sets the per-eye uniforms of a pass program,
+	// drawScene renders the bound target with a program at the given size.
+	void renderOffscreen(int eye,
+		const std::function<void(GLuint)>& setUniforms,
+		const std::function<void(GLuint, OVR::Sizei)>& drawScene) {
+		glState().disable(GL_FRAMEBUFFER_SRGB);
+		glState().bindFramebuffer(fboId);
+
+		for (int i : scheduleWithOutput()) {
+			GraphPassEye& e = eyes[eye][i];
+			e.executed = false;
+			e.previousTexId = e.persistentTexId[e.current];
+		}
+		for (int s = 0; s < (int)schedule.size(); s++) {
+			const int i = schedule[s];
+			const GraphPass& p = passes[i];
+			GraphPassEye& e = eyes[eye][i];
+			bool execute = !p.once || !e.valid;
+			for (const GraphPassInput& in : p.inputs) { execute = execute || eyes[eye][in.pass].executed; }
+			if (execute) {
+				GlDebugGroup group(p.name);
+				if (p.feedback) { e.current = 1 - e.current; }
+				OVR::Sizei size = passSize(eye, i);
+				e.texId = p.persistent() ? e.persistentTexId[e.current] : acquire(size);
+				glState().bindFramebuffer(fboId);
+				glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, e.texId, 0);
+				glState().viewport(0, 0, size.w, size.h);
+				glState().useProgram(p.program);
+				setUniforms(p.program);
+				bindInputs(eye, i);
+				drawScene(p.program, size);
+				e.valid = true;
+				e.executed = true;
+			}
+			releaseInputs(eye, s);
+		}
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, 0, 0);
+	}
+
+	// Output pass into the bound eye buffer.
+	void renderOutput(int eye,
+		const std::function<void(GLuint)>& setUniforms,
+		const std::function<void(GLuint, OVR::Sizei)>& drawScene) {
+		const GraphPass& p = passes[outputPass];
+		GlDebugGroup group(p.name);
+		glState().useProgram(p.program);
+		setUniforms(p.program);
+		bindInputs(eye, outputPass);
+		drawScene(p.program, passSize(eye, outputPass));
+		releaseInputs(eye, (int)schedule.size());
+	}
+
+private:
+	// Returns the transient outputs whose last reader is at schedule position s to the pool.
+	void releaseInputs(int eye, int s) {
+		for (int i : schedule) {
+			const GraphPass& q = passes[i];
+			if (!q.persistent() && q.lastReader == s && eyes[eye][i].texId != 0) {
+				release(eyes[eye][i].texId);
+				eyes[eye][i].texId = 0;
+			}
+		}
+	}
+};
@@ -0,0 +1,642 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include "GlState.h"
+
+// A "// @name arg1 arg2 ..." line in a shader file. Lets a shader declare things to the app (sweepable knobs etc.)
+struct ShaderDirective {
+	std::string name;
+	std::vector<std::string> args;
+
+	// Numbers are parsed without exceptions, a typo in a shader being edited must not take the app down on reload.
+	// Returns false and leaves value as it is unless the whole text is a finite number in range.
+	static bool parseNumber(const std::string& text, float& value) {
+		const char* begin = text.c_str();
+		char* end = nullptr;
+		errno = 0;
+		float v = std::strtof(begin, &end);
+		if (end == begin || *end != '\0' || errno == ERANGE || !std::isfinite(v)) { return false; }
+		value = v;
+		return true;
+	}
+
+	static bool parseNumber(const std::string& text, double& value) {
+		const char* begin = text.c_str();
+		char* end = nullptr;
+		errno = 0;
+		double v = std::strtod(begin, &end);
+		if (end == begin || *end != '\0' || errno == ERANGE || !std::isfinite(v)) { return false; }
+		value = v;
+		return true;
+	}
+
+	static bool parseNumber(const std::string& text, int& value) {
+		const char* begin = text.c_str();
+		char* end = nullptr;
+		errno = 0;
+		long v = std::strtol(begin, &end, 10);
+		if (end == begin || *end != '\0' || errno == ERANGE || v < INT_MIN || v > INT_MAX) { return false; }
+		value = (int)v;
+		return true;
+	}
+
+	static bool parseNumber(const std::string& text, unsigned& value) {
+		const char* begin = text.c_str();
+		char* end = nullptr;
+		errno = 0;
+		long long v = std::strtoll(begin, &end, 10);
+		if (end == begin || *end != '\0' || errno == ERANGE || v < 0 || v > UINT_MAX) { return false; }
+		value = (unsigned)v;
+		return true;
+	}
+
+	// Argument i as a number if it is one, otherwise says so and returns false
+	template <typename T>
+	bool number(size_t i, T& value) const {
+		if (i >= args.size()) { return false; }
+		if (parseNumber(args[i], value)) { return true; }
+		std::cout << "@" << name << ": " << args[i] << " is not a valid number, ignored" << std::endl;
+		return false;
+	}
+};
+
+typedef std::vector<std::pair<std::string, std::string>> ShaderDefines;
+
+// Common code injected into every shader after its #version line.
+// The app computes the per-eye ray basis from the eye's FOV, so that world space ray direction
+// through window pixel (x, y) is rayCorner + x * rayDx + y * rayDy
+const static char* shaderPrelude = R"GLSL(
+#ifdef RAY_DEPTH
+#extension GL_ARB_conservative_depth : enable
+#endif
+#if defined(COST_HEATMAP) || defined(INSTANCE_GRID)
+#extension GL_ARB_shader_storage_buffer_object : require
+#extension GL_ARB_shading_language_420pack : require
+#endif
+#ifdef COST_HEATMAP
+#extension GL_ARB_shader_image_load_store : require
+#endif
+uniform vec2 resolution = vec2(1344, 1600);
+uniform vec3 rayCorner = vec3(-1.0, -1.19, -1.0);
+uniform vec3 rayDx = vec3(2.0 / 1344.0, 0.0, 0.0);
+uniform vec3 rayDy = vec3(0.0, 2.38 / 1600.0, 0.0);
+
+vec3 rayDirection() {
+    return normalize(rayCorner + gl_FragCoord.x * rayDx + gl_FragCoord.y * rayDy);
+}
+
+// Depth of the hit t along rayDirection(), for the compositor's positional reprojection at reduced frame rates.
+// Only written when the app builds the shader with RAY_DEPTH, it's a no-op otherwise. Depth only gets larger than the
+// fullscreen triangle's (at the near plane), so early depth testing against the hidden area keeps working.
+uniform vec3 eyeForward = vec3(0.0, 0.0, -1.0);
+uniform vec2 depthPlanes = vec2(0.2, 1000.0);
+#ifdef RAY_DEPTH
+layout(depth_greater) out float gl_FragDepth;
+#endif
+void writeRayDepth(float t) {
+#ifdef RAY_DEPTH
+    float n = depthPlanes.x;
+    float f = depthPlanes.y;
+    float d = clamp(t * dot(rayDirection(), eyeForward), n, f);
+    gl_FragDepth = f / (f - n) - f * n / ((f - n) * d); // ovrProjection_None, 0 at near and 1 at far
+#endif
+}
+
+// Mono far field (see FarField.h): march only within marchRange. With NEAR_FIELD, what lies beyond it comes from
+// the far field marched once from between the eyes, looked up along rayDirection() by farFieldColor()
+uniform vec2 marchRange = vec2(0.0, 1e9);
+#ifdef NEAR_FIELD
+uniform sampler2D farField;
+uniform vec3 farSide;
+uniform vec3 farUp;
+uniform vec3 farForward;
+uniform vec2 farTanMin;
+uniform vec2 farTanSize;
+vec4 farFieldColor() {
+    vec3 rd = rayDirection();
+    vec2 uv = (vec2(dot(rd, farSide), dot(rd, farUp)) / dot(rd, farForward) - farTanMin) / farTanSize;
+    return texture(farField, uv);
+}
+#endif
+
+// Noise textures (see NoiseLibrary.h), tileable and bound for every shader: one fetch instead of hash math per sample
+uniform sampler2D noiseWhite;  // 256x256, four independent uniform values per texel
+uniform sampler3D noiseValue;  // 32^3 random lattice values
+uniform sampler3D noisePerlin; // gradient noise, 8 lattice cells per repeat
+uniform sampler2D noiseBlue;   // 64x64 void-and-cluster ranks
+
+// Four independent uniform values in [0, 1] for an integer lattice point, repeats every 256
+vec4 hashTex(ivec2 i) { return texelFetch(noiseWhite, i & 255, 0); }
+vec4 hashTex(ivec3 i) { return hashTex(i.xy + i.z * ivec2(73, 151)); }
+
+// Smooth value noise in [0, 1], repeats every 32 units. Fetched at the smoothed fraction, the sampler's trilinear
+// filter weights the 8 lattice values like the usual smoothstep interpolation.
+float valueNoiseTex(vec3 p) {
+    vec3 i = floor(p);
+    vec3 f = fract(p);
+    f = f * f * (3.0 - 2.0 * f);
+    return texture(noiseValue, (i + f + 0.5) / 32.0).r;
+}
+
+// Perlin gradient noise, signed and 0 at the integer lattice points, repeats every 8 units
+float perlinNoiseTex(vec3 p) { return texture(noisePerlin, p / 8.0 + 0.5 / 64.0).r; }
+
+// Blue noise in [0, 1] per pixel, e.g. to jitter samples without low frequency clumps, repeats every 64 pixels
+float blueNoiseTex(ivec2 pixel) { return texelFetch(noiseBlue, pixel & 63, 0).r; }
+
+// Screen tile culling (see TileCulling.h): distance along rayDirection() up to which the app proved this pixel's
+// tile of the eye empty, 0 without culling. Past any march range (1e9) when the tile has nothing to hit at all.
+uniform bool tileCulling = false;
+uniform sampler2D tileStarts;
+uniform vec2 tilesPerEye = vec2(42.0, 50.0);
+float tileStartDistance() {
+    if (!tileCulling) return 0.0;
+    ivec2 tile = min(ivec2(gl_FragCoord.xy / resolution * tilesPerEye), textureSize(tileStarts, 0) - 1);
+    return texelFetch(tileStarts, tile, 0).r;
+}
+
+// Cost heatmap (see CostHeatmap.h): built with COST_HEATMAP, the shader's map() calls and for loop iterations are
+// counted per pixel (ShaderSource::instrumentCost). Both go into a histogram the app reads back, and one of them is
+// shown in false color instead of the shader's output. Tests run early, so the hidden area isn't counted.
+#ifdef COST_HEATMAP
+layout(early_fragment_tests) in;
+#define COST_BINS 256
+layout(std430, binding = 0) buffer CostHistogram {
+    uint costPixels;
+    uint costMax[2];
+    uint costSum[4];              // 64 bit sums, low and high word
+    uint costBins[2 * COST_BINS]; // map calls, then loop iterations
+};
+uniform int costView = 0;        // 0 map calls, 1 loop iterations
+uniform float costRange = 256.0; // count shown in red
+uniform float costBinWidth = 4.0;
+int costMapCalls = 0;
+int costIterations = 0;
+#define COST_MAP_CALL() costMapCalls++
+
+void costAdd(int counter, uint count) {
+    atomicMax(costMax[counter], count);
+    uint low = atomicAdd(costSum[counter * 2], count);
+    if (low + count < low) atomicAdd(costSum[counter * 2 + 1], 1u);
+    atomicAdd(costBins[counter * COST_BINS + min(int(float(count) / costBinWidth), COST_BINS - 1)], 1u);
+}
+
+// blue, cyan, green, yellow, red for 0 to 1
+vec3 costColor(float x) {
+    x = clamp(x, 0.0, 1.0) * 4.0;
+    return clamp(vec3(x - 2.0, x < 2.0 ? x : 4.0 - x, 2.0 - x), 0.0, 1.0);
+}
+#else
+#define COST_MAP_CALL()
+#endif
+
+// Instance grid (see InstanceGrid.h): primitive instances binned into a uniform grid of cells
+#ifdef INSTANCE_GRID
+#ifndef GRID_STEPS
+#define GRID_STEPS 512
+#endif
+#ifndef GRID_PRECISION
+#define GRID_PRECISION 0.0005
+#endif
+layout(std430, binding = 1) readonly buffer GridInstances {
+    vec4 instanceData[]; // 3 per instance: position.xyz type, rotation quaternion, size.xyz material
+};
+layout(std430, binding = 2) readonly buffer GridCells {
+    ivec2 gridCells[]; // first list entry and instance count per cell, x fastest
+};
+layout(std430, binding = 3) readonly buffer GridLists {
+    int gridLists[]; // instance indices of all cells
+};
+uniform vec3 gridMin = vec3(0.0);
+uniform float gridCellSize = 1.0;
+uniform ivec3 gridDims = ivec3(1);
+uniform int instanceCount = 0;
+
+// Distance to instance i, and its material
+float instanceDistance(int i, vec3 p, out float material) {
+    vec4 a = instanceData[i * 3];
+    vec4 q = instanceData[i * 3 + 1];
+    vec4 s = instanceData[i * 3 + 2];
+    material = s.w;
+    vec3 v = p - a.xyz;
+    v = v + 2.0 * cross(q.xyz, cross(q.xyz, v) - q.w * v); // by the inverse rotation
+    int type = int(a.w);
+    if (type == 0) {
+        return length(v) - s.x;
+    }
+    if (type == 1) {
+        vec3 d = abs(v) - s.xyz;
+        return min(max(d.x, max(d.y, d.z)), 0.0) + length(max(d, 0.0));
+    }
+    return length(vec2(length(v.xz) - s.x, v.y)) - s.y;
+}
+
+// Closest instance listed in a cell, instance index and material in hit.xy
+float cellDistance(ivec3 cell, vec3 p, out vec2 hit) {
+    COST_MAP_CALL();
+    ivec2 list = gridCells[(cell.z * gridDims.y + cell.y) * gridDims.x + cell.x];
+    float d = 1e9;
+    hit = vec2(-1.0, 0.0);
+    for (int k = 0; k < list.y; k++) {
+        int i = gridLists[list.x + k];
+        float material;
+        float di = instanceDistance(i, p, material);
+        if (di < d) {
+            d = di;
+            hit = vec2(float(i), material);
+        }
+    }
+    return d;
+}
+
+// Scene distance near p from the instances overlapping p's cell, e.g. for normals at a hit
+float gridMap(vec3 p) {
+    ivec3 cell = clamp(ivec3(floor((p - gridMin) / gridCellSize)), ivec3(0), gridDims - 1);
+    vec2 hit;
+    return cellDistance(cell, p, hit);
+}
+
+// Every instance, for comparison: the cost of a step grows with the instance count
+float instancesMap(vec3 p, out vec2 hit) {
+    float d = 1e9;
+    hit = vec2(-1.0, 0.0);
+    for (int i = 0; i < instanceCount; i++) {
+        float material;
+        float di = instanceDistance(i, p, material);
+        if (di < d) {
+            d = di;
+            hit = vec2(float(i), material);
+        }
+    }
+    return d;
+}
+
+// Sphere traces the ray through the grid cells it crosses (3D DDA). Within a cell only its instances are evaluated,
+// and steps end at the cell's exit since other instances could be right behind it. Empty cells take one step.
+// Returns the hit distance and instance index and material in hit.xy, or -1 for a miss.
+float gridMarch(vec3 ro, vec3 rd, float tmin, float tmax, out vec2 hit) {
+    hit = vec2(-1.0, 0.0);
+    vec3 gridMax = gridMin + vec3(gridDims) * gridCellSize;
+    vec3 inv = 1.0 / rd;
+    vec3 t0 = (gridMin - ro) * inv;
+    vec3 t1 = (gridMax - ro) * inv;
+    vec3 tNear = min(t0, t1);
+    vec3 tFar = max(t0, t1);
+    float t = max(tmin, max(tNear.x, max(tNear.y, tNear.z)));
+    tmax = min(tmax, min(tFar.x, min(tFar.y, tFar.z)));
+    if (t > tmax) return -1.0;
+
+    ivec3 cell = clamp(ivec3(floor((ro + rd * t - gridMin) / gridCellSize)), ivec3(0), gridDims - 1);
+    ivec3 stepDir = ivec3(sign(rd));
+    vec3 tDelta = abs(gridCellSize * inv);
+    vec3 tNext = (gridMin + (vec3(cell) + step(0.0, rd)) * gridCellSize - ro) * inv;
+    for (int i = 0; i < GRID_STEPS; i++) {
+        float exitT = min(tNext.x, min(tNext.y, tNext.z));
+        vec2 cellHit;
+        float d = cellDistance(cell, ro + rd * t, cellHit);
+        if (d < GRID_PRECISION * t) {
+            hit = cellHit;
+            return t;
+        }
+        t = min(t + d, exitT);
+        if (t >= exitT) {
+            // next cell along the axis whose boundary is closest
+            if (tNext.x <= tNext.y && tNext.x <= tNext.z) { cell.x += stepDir.x; tNext.x += tDelta.x; }
+            else if (tNext.y <= tNext.z) { cell.y += stepDir.y; tNext.y += tDelta.y; }
+            else { cell.z += stepDir.z; tNext.z += tDelta.z; }
+            if (any(lessThan(cell, ivec3(0))) || any(greaterThanEqual(cell, gridDims))) break;
+        }
+        if (t > tmax) break;
+    }
+    return -1.0;
+}
+#endif
+
+// Temporal amortization: evaluate 1/temporalPhases of the stochastic samples, picked by temporalFrame
+uniform int temporalFrame = 0;
+uniform int temporalPhases = 1;
+
+// Phase of the samples this pixel evaluates this frame. Neighbors are offset (a 2x2 quad covers four phases, blue
+// noise spreads larger counts), so each 3x3 neighborhood the resolve clamps the history to holds all of them.
+int temporalPhase() {
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    int offset = (p.x & 1) + 2 * (p.y & 1) + 4 * int(blueNoiseTex(p) * 16.0);
+    return (temporalFrame + offset) % temporalPhases;
+}
+#if defined(TEMPORAL) || defined(PASS_PRIMARY)
+layout(location = 1) out float rayHitDistance; // distance from ro along rayDirection(), to reproject the history or upsample
+#endif
+
+// Split pipeline (see SplitRenderer.h): the effect and composite passes read the full resolution primary hit,
+// normal.xyz + aux in primarySurface and the hit distance in primaryDistance
+#if defined(PASS_EFFECT) || defined(PASS_COMPOSITE)
+uniform sampler2D primarySurface;
+uniform sampler2D primaryDistance;
+uniform vec2 primarySize = vec2(1344, 1600);
+
+// Primary texel under a window position given in this pass's pixels
+ivec2 primaryTexel(vec2 fragCoord) {
+    return clamp(ivec2(fragCoord / resolution * primarySize), ivec2(0), ivec2(primarySize) - 1);
+}
+vec4 primarySurfaceHere() { return texelFetch(primarySurface, primaryTexel(gl_FragCoord.xy), 0); }
+float primaryDistanceHere() { return texelFetch(primaryDistance, primaryTexel(gl_FragCoord.xy), 0).r; }
+#endif
+
+#ifdef PASS_COMPOSITE
+uniform sampler2D effectBuffer;
+uniform vec2 effectSize = vec2(672, 800);
+
+// Joint bilateral upsample of the effect buffer: bilinear weights of the 4 nearest effect texels, scaled down
+// for those whose primary hit (as seen by the effect pass) differs in distance or normal from this pixel's
+vec4 upsampledEffect() {
+    vec2 pe = gl_FragCoord.xy * effectSize / primarySize - 0.5;
+    vec2 base = floor(pe);
+    vec2 f = pe - base;
+    vec4 surface = texelFetch(primarySurface, ivec2(gl_FragCoord.xy), 0);
+    float z = texelFetch(primaryDistance, ivec2(gl_FragCoord.xy), 0).r;
+    vec4 sum = vec4(0.0);
+    vec4 bilinear = vec4(0.0);
+    float total = 0.0;
+    for (int i = 0; i < 4; i++) {
+        vec2 offset = vec2(i & 1, i >> 1);
+        vec2 texel = clamp(base + offset, vec2(0.0), effectSize - 1.0);
+        ivec2 source = clamp(ivec2((texel + 0.5) / effectSize * primarySize), ivec2(0), ivec2(primarySize) - 1);
+        float zs = texelFetch(primaryDistance, source, 0).r;
+        vec3 ns = texelFetch(primarySurface, source, 0).xyz;
+        float wb = mix(1.0 - f.x, f.x, offset.x) * mix(1.0 - f.y, f.y, offset.y);
+        float wz = 1.0 / (1e-3 + abs(zs - z) / max(z, 1e-3) * 32.0);
+        float wn = pow(max(dot(ns, surface.xyz), 0.0), 8.0);
+        vec4 e = texelFetch(effectBuffer, ivec2(texel), 0);
+        sum += e * wb * wz * wn;
+        total += wb * wz * wn;
+        bilinear += e * wb;
+    }
+    // no neighbor on the same surface, e.g. thin features missed at low resolution
+    return total > 1e-4 ? sum / total : bilinear;
+}
+#endif
+
+// Render graph passes (see RenderGraph.h): outputs of the passes listed in "// @pass NAME in:..." in that order
+#ifdef GRAPH_PASS
+uniform sampler2D iChannel0;
+uniform sampler2D iChannel1;
+uniform sampler2D iChannel2;
+uniform sampler2D iChannel3;
+uniform vec2 iChannelResolution[4];
+#endif
+
+// the shader's main() runs from the one the app appends (shaderCostEpilogue)
+#ifdef COST_HEATMAP
+#define main shaderMain
+#endif
+)GLSL";
+
+// Appended to shaders built with COST_HEATMAP: runs the shader, then counts the pixel and replaces its color
+const static char* shaderCostEpilogue = R"GLSL(
+#undef main
+void main() {
+    shaderMain();
+    atomicAdd(costPixels, 1u);
+    costAdd(0, uint(costMapCalls));
+    costAdd(1, uint(costIterations));
+    fragColor = vec4(costColor(float(costView == 0 ? costMapCalls : costIterations) / costRange), 1.0);
+}
+)GLSL";
+
+// Shader file split at its #version line so that defines can be injected without breaking the version requirement.
+struct ShaderSource {
+	std::string header; // everything up to and including the #version line
+	std::string body;
+	int bodyFirstLine = 1;
+	std::vector<ShaderDirective> directives;
+
+	bool load(const std::string& filepath) {
+		std::ifstream input_file(filepath);
+		if (!input_file.is_open()) { std::cerr << "Could not open file: " << filepath << std::endl; return false; }
+		std::string text = std::string((std::istreambuf_iterator<char>(input_file)), std::istreambuf_iterator<char>());
+		parse(text);
+		return true;
+	}
+
+	void parse(const std::string& text) {
+		header.clear();
+		body.clear();
+		directives.clear();
+		bodyFirstLine = 1;
+
+		std::istringstream lines(text);
+		std::string line;
+		std::vector<std::string> all;
+		int versionLine = -1;
+		while (std::getline(lines, line)) {
+			if (versionLine < 0 && line.find("#version") != std::string::npos) { versionLine = (int)all.size(); }
+			parseDirective(line);
+			all.push_back(line);
+		}
+		for (int i = 0; i < (int)all.size(); i++) {
+			std::string& dst = i <= versionLine ? header : body;
+			dst += all[i] + "\n";
+		}
+		bodyFirstLine = versionLine + 2;
+	}
+
+	const ShaderDirective* findDirective(const std::string& name) const {
+		for (const ShaderDirective& d : directives) {
+			if (d.name == name) { return &d; }
+		}
+		return nullptr;
+	}
+
+	// Final source: version, defines, prelude, then the original code with its line numbers restored for compiler logs.
+	std::string build(const ShaderDefines& defines) const {
+		std::string code = header;
+		bool cost = false;
+		for (const auto& def : defines) {
+			code += "#define " + def.first + " " + def.second + "\n";
+			cost = cost || def.first == "COST_HEATMAP";
+		}
+		code += shaderPrelude;
+		code += "#line " + std::to_string(bodyFirstLine) + "\n";
+		if (cost) { code += instrumentCost() + shaderCostEpilogue; }
+		else { code += body; }
+		return code;
+	}
+
+	// The body with a counter increment added to every for loop's iteration expression, and calls of a one parameter
+	// map() counted from after its definition (a macro of the same name, calls within map() itself aren't counted).
+	// While loops aren't counted. Line numbers stay those of the file.
+	std::string instrumentCost() const {
+		std::string code = body;
+		size_t mapEnd = std::string::npos;
+		for (size_t i = 0; i < code.size(); i++) {
+			i = skipComments(code, i);
+			if (i >= code.size()) { break; }
+			if (wordAt(code, i, "for")) {
+				size_t open = code.find_first_not_of(" \t\r\n", i + 3);
+				if (open == std::string::npos || code[open] != '(') { continue; }
+				size_t semicolons[2];
+				int found = 0, depth = 0;
+				size_t close = open;
+				for (; close < code.size(); close++) {
+					close = skipComments(code, close);
+					if (close >= code.size()) { break; }
+					char c = code[close];
+					if (c == '(') { depth++; }
+					else if (c == ')' && --depth == 0) { break; }
+					else if (c == ';' && depth == 1 && found < 2) { semicolons[found++] = close; }
+				}
+				if (close >= code.size() || found < 2) { continue; }
+				bool emptyStep = code.find_first_not_of(" \t\r\n", semicolons[1] + 1) == close;
+				code.insert(close, emptyStep ? "costIterations++" : ", costIterations++");
+				i = close;
+			}
+			else if (mapEnd == std::string::npos && wordAt(code, i, "map")) {
+				mapEnd = mapDefinitionEnd(code, i);
+			}
+		}
+		if (mapEnd == std::string::npos) {
+			std::cout << "No one parameter map() found, only loop iterations are counted" << std::endl;
+			return code;
+		}
+		// at the start of the line after the definition
+		size_t lineEnd = code.find('\n', mapEnd);
+		size_t at = lineEnd == std::string::npos ? code.size() : lineEnd + 1;
+		int line = bodyFirstLine + (int)std::count(code.begin(), code.begin() + at, '\n');
+		code.insert(at, "#define map(p) (costMapCalls++, map(p))\n#line " + std::to_string(line) + "\n");
+		return code;
+	}
+
+private:
+	// Index past a comment starting at i, or i
+	static size_t skipComments(const std::string& code, size_t i) {
+		while (i + 1 < code.size() && code[i] == '/' && (code[i + 1] == '/' || code[i + 1] == '*')) {
+			size_t end = code[i + 1] == '/' ? code.find('\n', i) : code.find("*/", i + 2);
+			i = end == std::string::npos ? code.size() : end + (code[i + 1] == '/' ? 0 : 2);
+		}
+		return i;
+	}
+
+	static bool isIdentifier(char c) { return isalnum((unsigned char)c) || c == '_'; }
+
+	static bool wordAt(const std::string& code, size_t i, const char* word) {
+		size_t n = strlen(word);
+		return code.compare(i, n, word) == 0 && (i == 0 || !isIdentifier(code[i - 1]))
+			&& (i + n >= code.size() || !isIdentifier(code[i + n]));
+	}
+
+	// When "map" at i names a definition with a float or vecN result and one parameter: the index of its closing brace
+	static size_t mapDefinitionEnd(const std::string& code, size_t i) {
+		if (i == 0) { return std::string::npos; }
+		size_t typeEnd = code.find_last_not_of(" \t\r\n", i - 1);
+		if (typeEnd == std::string::npos) { return std::string::npos; }
+		size_t typeBegin = typeEnd;
+		while (typeBegin > 0 && isIdentifier(code[typeBegin - 1])) { typeBegin--; }
+		std::string type = code.substr(typeBegin, typeEnd + 1 - typeBegin);
+		if (type != "float" && type != "vec2" && type != "vec3" && type != "vec4") { return std::string::npos; }
+		size_t open = code.find_first_not_of(" \t\r\n", i + 3);
+		if (open == std::string::npos || code[open] != '(') { return std::string::npos; }
+		size_t close = code.find(')', open);
+		if (close == std::string::npos || code.find(',', open) < close) { return std::string::npos; }
+		size_t brace = code.find_first_not_of(" \t\r\n", close + 1);
+		if (brace == std::string::npos || code[brace] != '{') { return std::string::npos; } // a prototype
+		int depth = 0;
+		for (size_t j = brace; j < code.size(); j++) {
+			j = skipComments(code, j);
+			if (j >= code.size()) { break; }
+			if (code[j] == '{') { depth++; }
+			else if (code[j] == '}' && --depth == 0) { return j; }
+		}
+		return std::string::npos;
+	}
+
+	void parseDirective(const std::string& line) {
+		size_t start = line.find_first_not_of(" \t");
+		if (start == std::string::npos || line.compare(start, 4, "// @") != 0) { return; }
+		std::istringstream words(line.substr(start + 4));
+		ShaderDirective d;
+		words >> d.name;
+		std::string arg;
+		while (words >> arg) { d.args.push_back(arg); }
+		if (!d.name.empty()) { directives.push_back(d); }
+	}
+};
+
+// Compiles the source into the given shader object and prints the info log. Returns false on compile failure.
+inline bool compileShader(GLuint shaderId, const std::string& source) {
+	const char* code = source.c_str();
+	glShaderSource(shaderId, 1, &code, 0);
+	glCompileShader(shaderId);
+	GLint is_compiled = 0;
+	glGetShaderiv(shaderId, GL_COMPILE_STATUS, &is_compiled);
+	GLint logLength = 0;
+	glGetShaderiv(shaderId, GL_INFO_LOG_LENGTH, &logLength);
+	// Can compile and have warnings, or can fail and have errors etc.
+	if (logLength > 0) {
+		std::vector<GLchar> infoLog(logLength);
+		glGetShaderInfoLog(shaderId, logLength, NULL, &infoLog[0]);
+		std::cout << "Log: " << std::string(infoLog.begin(), infoLog.end()) << std::endl;
+	}
+	if (is_compiled == GL_FALSE) {
+		std::cout << "Shader compilation failed." << is_compiled << std::endl;
+		return false;
+	}
+	return true;
+}
+
+// Vertex stage of every program (see FullscreenTriangle.h): the fullscreen triangle from gl_VertexID, or positions
+// from attribute 0 for meshes and immediate mode quads
+const static char* fullscreenVertexSource = R"GLSL(
+#version 410
+uniform float fullscreenDepth = 0.0; // clip space z of the triangle
+uniform bool vertexPositions = false;
+layout(location = 0) in vec4 position;
+void main() {
+    if (vertexPositions) {
+        gl_Position = position;
+    } else {
+        gl_Position = vec4(vec2((gl_VertexID << 1) & 2, gl_VertexID & 2) * 2.0 - 1.0, fullscreenDepth, 1.0);
+    }
+}
+)GLSL";
+
+// Compiled once and attached to every program, a core profile context has no fixed function vertex stage
+inline GLuint fullscreenVertexShader() {
+	static GLuint shaderId = 0;
+	if (!shaderId) {
+		shaderId = glCreateShader(GL_VERTEX_SHADER);
+		compileShader(shaderId, fullscreenVertexSource);
+	}
+	return shaderId;
+}
+
+// Builds a program out of a single fragment shader, the way all shaders here are drawn. Returns 0 on failure.
+inline GLuint linkFragmentProgram(const std::string& source) {
+	GLuint shaderId = glCreateShader(GL_FRAGMENT_SHADER);
+	if (!compileShader(shaderId, source)) { glDeleteShader(shaderId); return 0; }
+	GLuint programId = glCreateProgram();
+	glState().forgetProgram(programId);
+	glAttachShader(programId, fullscreenVertexShader());
+	glAttachShader(programId, shaderId);
+	// Unqualified fragColor next to the prelude's location 1 output
+	glBindFragDataLocation(programId, 0, "fragColor");
+	glLinkProgram(programId);
+	glDeleteShader(shaderId);
+	GLint is_linked = 0;
+	glGetProgramiv(programId, GL_LINK_STATUS, &is_linked);
+	if (is_linked == GL_FALSE) { std::cout << "Shader link failed." << std::endl; glDeleteProgram(programId); return 0; }
+	return programId;
+}
@@ -0,0 +1,201 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <new>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glad/glad.h>
+#include <Windows.h>
+
+#include <Extras/OVR_Math.h>
+
+#include "ReadbackRing.h"
+
+// Frames published to other processes (streaming, recording tools) through a named shared memory mapping, so they
+// don't have to scrape the mirror window. The mapping holds a header and a ring of slots. Each slot is guarded by a
+// sequence number, seqlock style: odd while it's written. Readers never block the writer. A reader checks that the
+// number was even and unchanged around its read, and retries with the newest slot if not.
+// Layout, shared with consumers, all little endian:
+//   SharedFrameHeader at offset 0
+//   slot i at headerBytes + i * slotStride: SharedFrameSlot, then width * height RGBA8 pixels at slot + slotHeaderBytes,
+//   rows y = 0 first (the top row for the mirror texture)
+const char* const sharedFrameName = "Local\\HelloCulusFrames";
+const uint32_t sharedFrameMagic = 0x58464348; // "HCFX"
+const uint32_t sharedFrameVersion = 1;
+
+struct SharedFrameHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t width;
+	uint32_t height;
+	uint32_t slotCount;
+	uint32_t slotStride;
+	std::atomic<int64_t> latest; // frame number of the newest complete frame, -1 before the first
+};
+
+struct SharedFrameSlot {
+	std::atomic<uint64_t> sequence;
+	int64_t frame;           // the slot is frame % slotCount
+	int64_t publishedNs;     // steady clock (QueryPerformanceCounter based on Windows, the same in every process)
+};
+
+const size_t sharedHeaderBytes = 64;
+const size_t sharedSlotHeaderBytes = 64;
+static_assert(sizeof(SharedFrameHeader) <= sharedHeaderBytes && sizeof(SharedFrameSlot) <= sharedSlotHeaderBytes, "shared frame layout");
+
+// Writer side. publish() reads the framebuffer back through a ReadbackRing and copies finished frames from the mapped
+// pixel buffer straight into the next slot, a few frames later. Nothing waits on the GPU or on readers.
+struct SharedFrameExport {
+	static const uint32_t slotCount = 3;
+	OVR::Sizei size;
+	ReadbackRing readback;
+	HANDLE mapping = nullptr;
+	unsigned char* view = nullptr;
+	int64_t published = 0;
+
+	explicit SharedFrameExport(OVR::Sizei size) :
+		size(size),
+		readback(size) {
+	}
+
+	~SharedFrameExport() {
+		close();
+	}
+
+	size_t slotStride() const { return sharedSlotHeaderBytes + readback.frameBytes(); }
+	size_t mappingBytes() const { return sharedHeaderBytes + slotCount * slotStride(); }
+	bool active() const { return view != nullptr; }
+
+	bool open() {
+		if (active()) { return true; }
+		const unsigned long long bytes = mappingBytes();
+		mapping = CreateFileMappingA(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, (DWORD)(bytes >> 32), (DWORD)bytes, sharedFrameName);
+		if (!mapping) { std::cout << "Can't create shared memory " << sharedFrameName << std::endl; return false; }
+		if (GetLastError() == ERROR_ALREADY_EXISTS) {
+			std::cout << sharedFrameName << " exists already, is another instance exporting?" << std::endl;
+			CloseHandle(mapping);
+			mapping = nullptr;
+			return false;
+		}
+		view = (unsigned char*)MapViewOfFile(mapping, FILE_MAP_ALL_ACCESS, 0, 0, (size_t)bytes);
+		if (!view) { CloseHandle(mapping); mapping = nullptr; return false; }
+		// fresh mappings are zeroed, every slot starts with an even sequence number
+		SharedFrameHeader* header = new (view) SharedFrameHeader();
+		header->width = size.w;
+		header->height = size.h;
+		header->slotCount = slotCount;
+		header->slotStride = (uint32_t)slotStride();
+		header->latest.store(-1);
+		header->version = sharedFrameVersion;
+		std::atomic_thread_fence(std::memory_order_release);
+		header->magic = sharedFrameMagic;
+		published = 0;
+		std::cout << "Exporting " << size.w << "x" << size.h << " frames to " << sharedFrameName << std::endl;
+		return true;
+	}
+
+	void close() {
+		if (!active()) { return; }
+		readback.collect([](const unsigned char*) {}, true);
+		UnmapViewOfFile(view);
+		CloseHandle(mapping);
+		view = nullptr;
+		mapping = nullptr;
+	}
+
+	// After the frame was submitted, like FrameCapture::capture
+	void publish(GLuint fboId) {
+		if (!active()) { return; }
+		readback.collect([this](const unsigned char* pixels) { write(pixels); });
+		readback.read(fboId);
+	}
+
+private:
+	void write(const unsigned char* pixels) {
+		const int64_t frame = published++;
+		unsigned char* slotBase = view + sharedHeaderBytes + (frame % slotCount) * slotStride();
+		SharedFrameSlot* slot = (SharedFrameSlot*)slotBase;
+		const uint64_t sequence = slot->sequence.load(std::memory_order_relaxed);
+		slot->sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+		slot->frame = frame;
+		slot->publishedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+		memcpy(slotBase + sharedSlotHeaderBytes, pixels, readback.frameBytes());
+		slot->sequence.store(sequence + 2, std::memory_order_release);
+		((SharedFrameHeader*)view)->latest.store(frame, std::memory_order_release);
+	}
+};
+
+// The test consumer (--read-frames): attaches to a running instance's export, reads the newest frame as it appears
+// and prints frames per second, frames it missed, torn reads it retried and the latency from publishing. The last
+// frame is written to HelloCulus-frame.ppm to check the image.
+struct SharedFrameReader {
+	int run(double seconds) {
+		HANDLE mapping = OpenFileMappingA(FILE_MAP_READ, 0, sharedFrameName);
+		if (!mapping) { std::cout << "No " << sharedFrameName << ", start HelloCulus with --export-frames first" << std::endl; return EXIT_FAILURE; }
+		const unsigned char* view = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (!view) { CloseHandle(mapping); return EXIT_FAILURE; }
+		const SharedFrameHeader* header = (const SharedFrameHeader*)view;
+		if (header->magic != sharedFrameMagic || header->version != sharedFrameVersion) {
+			std::cout << sharedFrameName << " has an unknown layout" << std::endl;
+			UnmapViewOfFile(view);
+			CloseHandle(mapping);
+			return EXIT_FAILURE;
+		}
+		const size_t frameBytes = (size_t)header->width * header->height * 4;
+		std::cout << "Reading " << header->width << "x" << header->height << " frames from " << sharedFrameName << std::endl;
+
+		std::vector<unsigned char> frame(frameBytes), copy(frameBytes);
+		int64_t last = -1;
+		long long received = 0, missed = 0, torn = 0;
+		double latencyMs = 0.0;
+		auto begin = std::chrono::steady_clock::now();
+		auto report = begin;
+		while (std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count() < seconds) {
+			const int64_t latest = header->latest.load(std::memory_order_acquire);
+			if (latest < 0 || latest == last) { std::this_thread::sleep_for(std::chrono::milliseconds(1)); continue; }
+			const unsigned char* slotBase = view + sharedHeaderBytes + (latest % header->slotCount) * header->slotStride;
+			const SharedFrameSlot* slot = (const SharedFrameSlot*)slotBase;
+			const uint64_t before = slot->sequence.load(std::memory_order_acquire);
+			const int64_t number = slot->frame;
+			const int64_t publishedNs = slot->publishedNs;
+			// A consumer that doesn't keep the frame would work on the slot's pixels in place instead
+			memcpy(copy.data(), slotBase + sharedSlotHeaderBytes, frameBytes);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if ((before & 1) || slot->sequence.load(std::memory_order_relaxed) != before || number != latest) { torn++; continue; }
+			frame.swap(copy);
+
+			if (last >= 0) { missed += std::max<int64_t>(0, number - last - 1); }
+			last = number;
+			received++;
+			auto now = std::chrono::steady_clock::now();
+			latencyMs += (std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count() - publishedNs) / 1e6;
+			double sinceReport = std::chrono::duration<double>(now - report).count();
+			if (sinceReport >= 1.0) {
+				std::cout << std::fixed << std::setprecision(1) << received / sinceReport << " frames/s, " << missed << " missed, "
+					<< torn << " torn reads retried, " << std::setprecision(2) << latencyMs / received << " ms latency" << std::endl;
+				received = missed = torn = 0;
+				latencyMs = 0.0;
+				report = now;
+			}
+		}
+		int width = header->width, height = header->height;
+		UnmapViewOfFile(view);
+		CloseHandle(mapping);
+		if (last < 0) { std::cout << "No frames published" << std::endl; return EXIT_FAILURE; }
+
+		std::ofstream ppm("HelloCulus-frame.ppm", std::ios::binary);
+		ppm << "P6\n" << width << " " << height << "\n255\n";
+		for (size_t i = 0; i < (size_t)width * height; i++) { ppm.write((const char*)&frame[i * 4], 3); }
+		std::cout << "Frame " << last << " written to HelloCulus-frame.ppm" << std::endl;
+		return EXIT_SUCCESS;
+	}
+};
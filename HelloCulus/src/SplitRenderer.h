@@ -0,0 +1,198 @@
+#pragma once
+#include <cmath>
+#include <functional>
+#include <iostream>
+#include <string>
+
+#include <glad/glad.h>
+
+#include <Extras/OVR_Math.h>
+
+#include "GlDebug.h"
+#include "GlState.h"
+#include "HiddenAreaMask.h"
+#include "ShaderSource.h"
+
+// Split pipeline for shaders that declare "// @split <scale>". The shader is built three times:
+//   PASS_PRIMARY:   full resolution. Marches the primary hit, writes normal.xyz + aux (e.g. material ID) to
+//                   fragColor and the hit distance to rayHitDistance.
+//   PASS_EFFECT:    <scale> resolution. Evaluates the expensive low-frequency terms from the primary surface.
+//   PASS_COMPOSITE: full resolution into the eye buffer. Shades from the primary surface, reading the effect terms
+//                   through upsampledEffect(), a joint bilateral upsample guided by primary distance and normal.
+// Without any PASS_ define the shader is expected to render everything at once, as usual.
+struct SplitEye {
+	GLuint primaryFboId = 0;
+	GLuint surfaceTexId = 0;
+	GLuint distanceTexId = 0;
+	GLuint depthRbId = 0;
+	GLuint effectFboId = 0;
+	GLuint effectTexId = 0;
+	OVR::Sizei effectSize;
+	bool primed = false;
+};
+
+struct SplitRenderer {
+	float scale = 0.5f;
+	OVR::Sizei eyeSize[2];
+	SplitEye eyes[2];
+	GLuint primaryProg = 0;
+	GLuint effectProg = 0;
+	GLuint compositeProg = 0;
+
+	SplitRenderer(const OVR::Sizei eyeBufferSize[2]) {
+		for (int eye = 0; eye < 2; eye++) {
+			eyeSize[eye] = eyeBufferSize[eye];
+			SplitEye& e = eyes[eye];
+			e.surfaceTexId = createTexture(eyeSize[eye], GL_RGBA16F);
+			e.distanceTexId = createTexture(eyeSize[eye], GL_R32F);
+			glGenRenderbuffers(1, &e.depthRbId);
+			glBindRenderbuffer(GL_RENDERBUFFER, e.depthRbId);
+			glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, eyeSize[eye].w, eyeSize[eye].h);
+			glGenFramebuffers(1, &e.primaryFboId);
+			glState().bindFramebuffer(e.primaryFboId);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, e.surfaceTexId, 0);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, e.distanceTexId, 0);
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, e.depthRbId);
+			glGenFramebuffers(1, &e.effectFboId);
+			glState().bindFramebuffer(0);
+		}
+	}
+
+	~SplitRenderer() {
+		for (int eye = 0; eye < 2; eye++) {
+			SplitEye& e = eyes[eye];
+			glDeleteFramebuffers(1, &e.primaryFboId);
+			glDeleteFramebuffers(1, &e.effectFboId);
+			glDeleteRenderbuffers(1, &e.depthRbId);
+			GLuint textures[3] = { e.surfaceTexId, e.distanceTexId, e.effectTexId };
+			glDeleteTextures(3, textures);
+		}
+		unload();
+	}
+
+	static GLuint createTexture(OVR::Sizei size, GLenum format) {
+		GLuint texId;
+		glGenTextures(1, &texId);
+		glBindTexture(GL_TEXTURE_2D, texId);
+		glTexStorage2D(GL_TEXTURE_2D, 1, format, size.w, size.h);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		return texId;
+	}
+
+	bool active() const { return compositeProg != 0; }
+
+	void unload() {
+		glDeleteProgram(primaryProg);
+		glDeleteProgram(effectProg);
+		glDeleteProgram(compositeProg);
+		primaryProg = effectProg = compositeProg = 0;
+	}
+
+	// Builds the three passes if the shader asks for a split pipeline. Returns whether it is active.
+	bool load(const ShaderSource& source, const ShaderDefines& defines) {
+		unload();
+		const ShaderDirective* d = source.findDirective("split");
+		if (!d) { return false; }
+		// a malformed scale keeps the current one
+		float newScale = d->args.empty() ? 0.5f : scale;
+		float parsed = 0.0f;
+		if (d->number(0, parsed)) {
+			if (parsed > 0.0f && parsed <= 1.0f) { newScale = parsed; }
+			else { std::cout << "@split: scale " << parsed << " is not in (0, 1], ignored" << std::endl; }
+		}
+		auto build = [&](const char* pass) {
+			ShaderDefines passDefines = defines;
+			passDefines.push_back({ pass, "1" });
+			return linkFragmentProgram(source.build(passDefines));
+		};
+		primaryProg = build("PASS_PRIMARY");
+		effectProg = build("PASS_EFFECT");
+		compositeProg = build("PASS_COMPOSITE");
+		if (!primaryProg || !effectProg || !compositeProg) {
+			std::cout << "Split pipeline disabled, one of its passes failed to build." << std::endl;
+			unload();
+			return false;
+		}
+		if (newScale != scale || !eyes[0].effectTexId) { resize(newScale); }
+		std::cout << "Split pipeline: effects at " << scale * 100.0f << "% resolution" << std::endl;
+		return true;
+	}
+
+	void resize(float newScale) {
+		scale = newScale;
+		for (int eye = 0; eye < 2; eye++) {
+			SplitEye& e = eyes[eye];
+			glDeleteTextures(1, &e.effectTexId);
+			e.effectSize = OVR::Sizei((int)std::ceil(eyeSize[eye].w * scale), (int)std::ceil(eyeSize[eye].h * scale));
+			e.effectTexId = createTexture(e.effectSize, GL_RGBA16F);
+			glState().bindFramebuffer(e.effectFboId);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, e.effectTexId, 0);
+			glState().bindFramebuffer(0);
+		}
+	}
+
+	void invalidate() {
+		for (int eye = 0; eye < 2; eye++) { eyes[eye].primed = false; }
+	}
+
+	void bindInputs(GLuint program, int eye, bool withEffect) {
+		SplitEye& e = eyes[eye];
+		glState().bindTexture(0, e.surfaceTexId);
+		glState().bindTexture(1, e.distanceTexId);
+		glProgramUniform1i(program, glGetUniformLocation(program, "primarySurface"), 0);
+		glProgramUniform1i(program, glGetUniformLocation(program, "primaryDistance"), 1);
+		glProgramUniform2f(program, glGetUniformLocation(program, "primarySize"), (float)eyeSize[eye].w, (float)eyeSize[eye].h);
+		if (withEffect) {
+			glState().bindTexture(2, e.effectTexId);
+			glProgramUniform1i(program, glGetUniformLocation(program, "effectBuffer"), 2);
+			glProgramUniform2f(program, glGetUniformLocation(program, "effectSize"), (float)e.effectSize.w, (float)e.effectSize.h);
+		}
+	}
+
+	// Primary and effect passes into offscreen targets. setUniforms sets the per-eye uniforms of a pass program,
+	// drawScene renders the bound target with a program at the given size.
+	void renderOffscreen(int eye, const HiddenAreaMask* hiddenArea,
+		const std::function<void(GLuint)>& setUniforms,
+		const std::function<void(GLuint, OVR::Sizei)>& drawScene) {
+		GlDebugGroup group("split offscreen");
+		SplitEye& e = eyes[eye];
+		glState().disable(GL_FRAMEBUFFER_SRGB);
+
+		glState().bindFramebuffer(e.primaryFboId);
+		glState().viewport(0, 0, eyeSize[eye].w, eyeSize[eye].h);
+		const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glDrawBuffers(2, drawBuffers);
+		glClear(e.primed ? GL_COLOR_BUFFER_BIT : GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		if (!e.primed) {
+			if (hiddenArea) { hiddenArea->primeDepth(); }
+			e.primed = true;
+		}
+		glState().useProgram(primaryProg);
+		setUniforms(primaryProg);
+		drawScene(primaryProg, eyeSize[eye]);
+		glDrawBuffers(1, drawBuffers);
+
+		glState().bindFramebuffer(e.effectFboId);
+		glState().viewport(0, 0, e.effectSize.w, e.effectSize.h);
+		glClear(GL_COLOR_BUFFER_BIT);
+		glState().useProgram(effectProg);
+		setUniforms(effectProg);
+		bindInputs(effectProg, eye, false);
+		drawScene(effectProg, e.effectSize);
+
+	}
+
+	// Final shading into the bound eye buffer.
+	void renderComposite(int eye,
+		const std::function<void(GLuint)>& setUniforms,
+		const std::function<void(GLuint, OVR::Sizei)>& drawScene) {
+		GlDebugGroup group("split composite");
+		glState().useProgram(compositeProg);
+		setUniforms(compositeProg);
+		bindInputs(compositeProg, eye, true);
+		drawScene(compositeProg, eyeSize[eye]);
+	}
+};
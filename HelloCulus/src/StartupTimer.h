@@ -0,0 +1,35 @@
+#pragma once
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Wall clock breakdown of startup. lap() closes the step that ran since the previous one, steps that ran on
+// another thread meanwhile are added with overlapped() and printed apart, they don't count towards the total.
+struct StartupTimer {
+	std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::time_point last = begin;
+	std::vector<std::pair<std::string, double>> steps;
+	std::vector<std::pair<std::string, double>> background;
+
+	void lap(const std::string& name) {
+		auto now = std::chrono::steady_clock::now();
+		steps.push_back({ name, std::chrono::duration<double, std::milli>(now - last).count() });
+		last = now;
+	}
+
+	void overlapped(const std::string& name, double ms) {
+		background.push_back({ name, ms });
+	}
+
+	void print() const {
+		double total = std::chrono::duration<double, std::milli>(last - begin).count();
+		std::cout << std::fixed << std::setprecision(0) << "Startup: " << total << " ms";
+		for (size_t i = 0; i < steps.size(); i++) { std::cout << (i ? ", " : " (") << steps[i].first << " " << steps[i].second; }
+		if (!steps.empty()) { std::cout << ")"; }
+		for (const auto& s : background) { std::cout << ", " << s.first << " " << s.second << " ms alongside"; }
+		std::cout << std::endl;
+	}
+};
@@ -0,0 +1,209 @@
+#pragma once
+#include <algorithm>
+#include <functional>
+#include <iostream>
+
+#include <glad/glad.h>
+
+#include <OVR_CAPI.h>
+#include <Extras/OVR_Math.h>
+
+#include "EyeCamera.h"
+#include "FullscreenTriangle.h"
+#include "GlDebug.h"
+#include "GlState.h"
+#include "HiddenAreaMask.h"
+#include "ShaderSource.h"
+
+// Temporal amortization of stochastic shading (subsurface scattering, AO, soft shadows...).
+// Shaders that declare "// @temporal <phases>" are built with TEMPORAL defined and only evaluate 1/temporalPhases
+// of their samples each frame, rotating with temporalFrame and offset per pixel (temporalPhase()). They also write
+// rayHitDistance, so the resolve pass can reproject the history of the previous frame, clamp it to the current 3x3
+// neighborhood (which holds samples of every phase) and blend.
+struct TemporalEye {
+	GLuint currentFboId = 0;
+	GLuint currentColorTexId = 0;
+	GLuint currentHitTexId = 0;
+	GLuint depthRbId = 0;
+	GLuint historyTexId[2] = { 0, 0 };
+	int historyIndex = 0;
+	bool historyValid = false;
+	bool primed = false;
+	EyeCamera previousCamera;
+};
+
+struct TemporalAccumulator {
+	int phases = 4;
+	float minBlend = 0.1f; // keeps the history from going stale for pixels that don't get clamped
+	OVR::Sizei eyeSize[2];
+	TemporalEye eyes[2];
+	GLuint resolveProg;
+
+	TemporalAccumulator(const OVR::Sizei eyeBufferSize[2]) {
+		for (int eye = 0; eye < 2; eye++) {
+			eyeSize[eye] = eyeBufferSize[eye];
+			TemporalEye& e = eyes[eye];
+			e.currentColorTexId = createTexture(eyeSize[eye], GL_RGBA16F);
+			e.currentHitTexId = createTexture(eyeSize[eye], GL_R32F);
+			e.historyTexId[0] = createTexture(eyeSize[eye], GL_RGBA16F);
+			e.historyTexId[1] = createTexture(eyeSize[eye], GL_RGBA16F);
+			glGenRenderbuffers(1, &e.depthRbId);
+			glBindRenderbuffer(GL_RENDERBUFFER, e.depthRbId);
+			glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, eyeSize[eye].w, eyeSize[eye].h);
+			glGenFramebuffers(1, &e.currentFboId);
+			glState().bindFramebuffer(e.currentFboId);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, e.currentColorTexId, 0);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, e.currentHitTexId, 0);
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, e.depthRbId);
+			glState().bindFramebuffer(0);
+		}
+
+		resolveProg = linkFragmentProgram(R"GLSL(
+#version 410
+layout(location = 0) out vec4 eyeColor;
+layout(location = 1) out vec4 historyOut;
+uniform sampler2D currentColor;
+uniform sampler2D currentHit;
+uniform sampler2D history;
+uniform vec2 viewport;
+uniform vec3 ro;
+uniform vec3 rayCorner;
+uniform vec3 rayDx;
+uniform vec3 rayDy;
+uniform vec3 prevRo;
+uniform vec3 prevSide;
+uniform vec3 prevUp;
+uniform vec3 prevForward;
+uniform vec2 prevTanMin;
+uniform vec2 prevTanSize;
+uniform float blend;
+uniform int historyValid;
+void main() {
+    ivec2 p = ivec2(gl_FragCoord.xy);
+    ivec2 last = ivec2(viewport) - 1;
+    vec4 c = texelFetch(currentColor, p, 0);
+    vec4 lo = c;
+    vec4 hi = c;
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            vec4 n = texelFetch(currentColor, clamp(p + ivec2(x, y), ivec2(0), last), 0);
+            lo = min(lo, n);
+            hi = max(hi, n);
+        }
+    }
+
+    // where this pixel's surface point was seen in the previous frame
+    float t = texelFetch(currentHit, p, 0).r;
+    vec3 rd = normalize(rayCorner + gl_FragCoord.x * rayDx + gl_FragCoord.y * rayDy);
+    vec3 d = ro + rd * t - prevRo;
+    float z = dot(d, prevForward);
+    vec2 prevUv = (vec2(dot(d, prevSide), dot(d, prevUp)) / z - prevTanMin) / prevTanSize;
+
+    vec4 result = c;
+    if (historyValid != 0 && z > 0.0 && all(greaterThanEqual(prevUv, vec2(0.0))) && all(lessThanEqual(prevUv, vec2(1.0)))) {
+        vec4 h = clamp(texture(history, prevUv), lo, hi);
+        result = mix(h, c, blend);
+    }
+    eyeColor = result;
+    historyOut = result;
+}
+)GLSL");
+	}
+
+	~TemporalAccumulator() {
+		for (int eye = 0; eye < 2; eye++) {
+			TemporalEye& e = eyes[eye];
+			glDeleteFramebuffers(1, &e.currentFboId);
+			glDeleteRenderbuffers(1, &e.depthRbId);
+			GLuint textures[4] = { e.currentColorTexId, e.currentHitTexId, e.historyTexId[0], e.historyTexId[1] };
+			glDeleteTextures(4, textures);
+		}
+		glDeleteProgram(resolveProg);
+	}
+
+	static GLuint createTexture(OVR::Sizei size, GLenum format) {
+		GLuint texId;
+		glGenTextures(1, &texId);
+		glBindTexture(GL_TEXTURE_2D, texId);
+		glTexStorage2D(GL_TEXTURE_2D, 1, format, size.w, size.h);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		return texId;
+	}
+
+	// Drops the history, e.g. after a shader reload.
+	void reset() {
+		for (int eye = 0; eye < 2; eye++) { eyes[eye].historyValid = false; }
+	}
+
+	void invalidate() {
+		for (int eye = 0; eye < 2; eye++) { eyes[eye].primed = false; }
+	}
+
+	// Raymarches this frame's partial samples and hit distances. drawScene renders the bound target at the given size.
+	void renderCurrent(int eye, const HiddenAreaMask* hiddenArea, const std::function<void(OVR::Sizei)>& drawScene) {
+		GlDebugGroup group("temporal current");
+		TemporalEye& e = eyes[eye];
+		glState().bindFramebuffer(e.currentFboId);
+		glState().viewport(0, 0, eyeSize[eye].w, eyeSize[eye].h);
+		glState().disable(GL_FRAMEBUFFER_SRGB);
+		const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glDrawBuffers(2, drawBuffers);
+		glClear(e.primed ? GL_COLOR_BUFFER_BIT : GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		if (!e.primed) {
+			if (hiddenArea) { hiddenArea->primeDepth(); }
+			e.primed = true;
+		}
+		drawScene(eyeSize[eye]);
+		glDrawBuffers(1, drawBuffers);
+	}
+
+	// Blends the current samples with the reprojected history into the bound eye buffer, and keeps the result as next history.
+	void resolve(int eye, const EyeCamera& camera, GLuint eyeFboId) {
+		GlDebugGroup group("temporal resolve");
+		TemporalEye& e = eyes[eye];
+		const int next = 1 - e.historyIndex;
+
+		glState().bindFramebuffer(eyeFboId);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, e.historyTexId[next], 0);
+		const GLenum drawBuffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+		glDrawBuffers(2, drawBuffers);
+
+		const OVR::Sizei& size = eyeSize[eye];
+		OVR::Vector3f rayCorner = camera.rayCorner();
+		OVR::Vector3f rayDx = camera.rayRight() / (float)size.w;
+		OVR::Vector3f rayDy = camera.rayUp() / (float)size.h;
+		const EyeCamera& prev = e.previousCamera;
+		glState().useProgram(resolveProg);
+		glProgramUniform2f(resolveProg, glGetUniformLocation(resolveProg, "viewport"), (float)size.w, (float)size.h);
+		glProgramUniform3f(resolveProg, glGetUniformLocation(resolveProg, "ro"), camera.position.x, camera.position.y, camera.position.z);
+		glProgramUniform3f(resolveProg, glGetUniformLocation(resolveProg, "rayCorner"), rayCorner.x, rayCorner.y, rayCorner.z);
+		glProgramUniform3f(resolveProg, glGetUniformLocation(resolveProg, "rayDx"), rayDx.x, rayDx.y, rayDx.z);
+		glProgramUniform3f(resolveProg, glGetUniformLocation(resolveProg, "rayDy"), rayDy.x, rayDy.y, rayDy.z);
+		glProgramUniform3f(resolveProg, glGetUniformLocation(resolveProg, "prevRo"), prev.position.x, prev.position.y, prev.position.z);
+		glProgramUniform3f(resolveProg, glGetUniformLocation(resolveProg, "prevSide"), prev.side.x, prev.side.y, prev.side.z);
+		glProgramUniform3f(resolveProg, glGetUniformLocation(resolveProg, "prevUp"), prev.up.x, prev.up.y, prev.up.z);
+		glProgramUniform3f(resolveProg, glGetUniformLocation(resolveProg, "prevForward"), prev.forward.x, prev.forward.y, prev.forward.z);
+		glProgramUniform2f(resolveProg, glGetUniformLocation(resolveProg, "prevTanMin"), prev.tanMin().x, prev.tanMin().y);
+		glProgramUniform2f(resolveProg, glGetUniformLocation(resolveProg, "prevTanSize"), prev.tanSize().x, prev.tanSize().y);
+		glProgramUniform1f(resolveProg, glGetUniformLocation(resolveProg, "blend"), std::max(1.0f / phases, minBlend));
+		glProgramUniform1i(resolveProg, glGetUniformLocation(resolveProg, "historyValid"), e.historyValid ? 1 : 0);
+		glProgramUniform1i(resolveProg, glGetUniformLocation(resolveProg, "currentColor"), 0);
+		glProgramUniform1i(resolveProg, glGetUniformLocation(resolveProg, "currentHit"), 1);
+		glProgramUniform1i(resolveProg, glGetUniformLocation(resolveProg, "history"), 2);
+		glState().bindTexture(0, e.currentColorTexId);
+		glState().bindTexture(1, e.currentHitTexId);
+		glState().bindTexture(2, e.historyTexId[e.historyIndex]);
+
+		fullscreen().draw(resolveProg);
+
+		glDrawBuffers(1, drawBuffers);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, 0, 0);
+
+		e.historyIndex = next;
+		e.historyValid = true;
+		e.previousCamera = camera;
+	}
+};
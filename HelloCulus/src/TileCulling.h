@@ -0,0 +1,154 @@
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <OVR_CAPI.h>
+#include <Extras/OVR_Math.h>
+
+#include "EyeCamera.h"
+#include "GlDebug.h"
+#include "GlState.h"
+#include "IntervalSdf.h"
+#include "ShaderSource.h"
+#include "WorkerPool.h"
+
+// Screen tile culling for shaders that declare "// @cull SCENE [tile pixels]", SCENE naming a CPU mirror of their
+// map() (see IntervalSdf.h). Each frame the rays of every tile of an eye are cut into depth segments, and the scene
+// is bounded over the box around each segment with interval arithmetic. The segments proven empty from the eye up to
+// the first one that may hold a surface give the tile's start distance, which the shader reads with
+// tileStartDistance() to skip that part of its march. Tiles proven empty to infinity get emptyDistance.
+struct TileCuller {
+	static const int textureUnit = 7;
+	int tilePixels = 32;
+	float firstSegment = 0.5f;   // length of the segment at the eye, the next ones grow by growth
+	float growth = 1.25f;
+	float maxDistance = 1000.0f; // beyond it one last segment reaches to infinity
+	float emptyDistance = 1e9f;  // past any march range, shaders treat the tile as a miss
+	// Shaders stop a bit before the surface (MARCH_EPSILON, relative precision), a box has to stay clear of that
+	float margin = 0.05f;
+	float relativeMargin = 0.005f;
+	IntervalScene scene;
+	OVR::Sizei eyeSize[2];
+	OVR::Sizei tiles[2];
+	GLuint startTexId[2] = { 0, 0 };
+	std::vector<float> starts[2];
+	WorkerPool pool;
+	double frameMs = 0.0; // CPU time of this frame's culling, both eyes
+	double smoothedMs = 0.0;
+	double emptyShare = 0.0; // of the last culled eye's tiles
+
+	explicit TileCuller(const OVR::Sizei eyeSizes[2]) {
+		for (int eye = 0; eye < 2; ++eye) { eyeSize[eye] = eyeSizes[eye]; }
+		glGenTextures(2, startTexId);
+		resize();
+	}
+
+	~TileCuller() {
+		glDeleteTextures(2, startTexId);
+	}
+
+	bool active() const { return (bool)scene; }
+
+	// Picks the shader's CPU scene. Returns whether culling is active.
+	bool load(const ShaderSource& source) {
+		scene = nullptr;
+		const ShaderDirective* d = source.findDirective("cull");
+		if (!d || d->args.empty()) { return false; }
+		scene = intervalScene(d->args[0]);
+		if (!scene) {
+			std::cout << "Tile culling disabled, no CPU scene named " << d->args[0] << " (see IntervalSdf.h)" << std::endl;
+			return false;
+		}
+		// a malformed tile size keeps the current one
+		int pixels = d->args.size() > 1 ? tilePixels : 32;
+		if (d->number(1, pixels)) { pixels = std::max(4, pixels); }
+		if (pixels != tilePixels) {
+			tilePixels = pixels;
+			resize();
+		}
+		std::cout << "Tile culling with the " << d->args[0] << " scene, " << tiles[0].w << "x" << tiles[0].h
+			<< " tiles of " << tilePixels << " pixels per eye on " << pool.size() << " threads" << std::endl;
+		return true;
+	}
+
+	// Start distances of an eye's tiles for this frame, uploaded and bound on textureUnit.
+	void cull(int eye, const EyeCamera& camera, float time) {
+		GlDebugGroup group("tile culling");
+		auto begin = std::chrono::steady_clock::now();
+		const OVR::Sizei& n = tiles[eye];
+		const OVR::Vector3f corner = camera.rayCorner();
+		const OVR::Vector3f right = camera.rayRight();
+		const OVR::Vector3f up = camera.rayUp();
+		std::vector<float>& out = starts[eye];
+		pool.parallelFor(n.h, [&](int row) {
+			Interval v((float)(row * tilePixels) / eyeSize[eye].h, (float)std::min((row + 1) * tilePixels, eyeSize[eye].h) / eyeSize[eye].h);
+			for (int col = 0; col < n.w; ++col) {
+				Interval u((float)(col * tilePixels) / eyeSize[eye].w, (float)std::min((col + 1) * tilePixels, eyeSize[eye].w) / eyeSize[eye].w);
+				// rayDirection() of every pixel in the tile
+				IntervalVec3 rd = normalize(IntervalVec3{
+					Interval(corner.x) + u * right.x + v * up.x,
+					Interval(corner.y) + u * right.y + v * up.y,
+					Interval(corner.z) + u * right.z + v * up.z });
+				out[row * n.w + col] = startDistance(camera.position, rd, time);
+			}
+		});
+		int empty = 0;
+		for (float s : out) { empty += s >= emptyDistance; }
+		emptyShare = (double)empty / out.size();
+
+		glState().bindTexture(textureUnit, startTexId[eye]);
+		glTextureSubImage2D(startTexId[eye], 0, 0, 0, n.w, n.h, GL_RED, GL_FLOAT, out.data());
+		frameMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+	}
+
+	// Smooths this frame's culling time for the status line and starts the next frame's.
+	void endFrame() {
+		smoothedMs = smoothedMs == 0.0 ? frameMs : smoothedMs * 0.95 + frameMs * 0.05;
+		frameMs = 0.0;
+	}
+
+	// Points a program at the eye's tiles, or tells it to march from its own start when culling is off
+	void setUniforms(GLuint program, int eye, bool enabled) const {
+		glProgramUniform1i(program, glGetUniformLocation(program, "tileCulling"), enabled ? 1 : 0);
+		glProgramUniform1i(program, glGetUniformLocation(program, "tileStarts"), textureUnit);
+		glProgramUniform2f(program, glGetUniformLocation(program, "tilesPerEye"),
+			(float)eyeSize[eye].w / tilePixels, (float)eyeSize[eye].h / tilePixels);
+	}
+
+private:
+	void resize() {
+		for (int eye = 0; eye < 2; ++eye) {
+			tiles[eye] = OVR::Sizei((eyeSize[eye].w + tilePixels - 1) / tilePixels, (eyeSize[eye].h + tilePixels - 1) / tilePixels);
+			starts[eye].assign(tiles[eye].w * tiles[eye].h, 0.0f);
+			glBindTexture(GL_TEXTURE_2D, startTexId[eye]);
+			glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, tiles[eye].w, tiles[eye].h, 0, GL_RED, GL_FLOAT, starts[eye].data());
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	// Distance along the bundle of rays up to which the scene is proven empty
+	float startDistance(const OVR::Vector3f& ro, const IntervalVec3& rd, float time) const {
+		const IntervalVec3 origin = { Interval(ro.x), Interval(ro.y), Interval(ro.z) };
+		float t0 = 0.0f;
+		float t1 = firstSegment;
+		for (;;) {
+			const bool last = t0 >= maxDistance;
+			if (last) { t1 = std::numeric_limits<float>::infinity(); }
+			Interval d = scene(origin + rd * Interval(t0, t1), time);
+			if (!(d.lo > margin + relativeMargin * std::min(t1, maxDistance))) { return t0; }
+			if (last) { return emptyDistance; }
+			t0 = t1;
+			t1 = t1 * growth;
+		}
+	}
+};
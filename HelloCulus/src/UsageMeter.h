@@ -0,0 +1,47 @@
+#pragma once
+#include <iomanip>
+#include <iostream>
+
+#include <Windows.h>
+
+#include <OVR_CAPI.h>
+
+#include "GpuTimer.h"
+
+// CPU and GPU load of the app over a period, e.g. while the HMD is worn and while it isn't.
+// CPU is the process time (all threads) relative to one core, GPU is the share of the period spent rendering the eyes.
+struct UsageMeter {
+	double wallStart = 0.0;
+	double cpuStart = 0.0;
+	double gpuStartMs = 0.0;
+	long long frames = 0;
+
+	static double processCpuSeconds() {
+		FILETIME creation, exit, kernel, user;
+		if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user)) { return 0.0; }
+		ULARGE_INTEGER k, u;
+		k.LowPart = kernel.dwLowDateTime;
+		k.HighPart = kernel.dwHighDateTime;
+		u.LowPart = user.dwLowDateTime;
+		u.HighPart = user.dwHighDateTime;
+		return (k.QuadPart + u.QuadPart) * 1e-7; // 100 ns units
+	}
+
+	void reset(const GpuTimer& timer) {
+		wallStart = ovr_GetTimeInSeconds();
+		cpuStart = processCpuSeconds();
+		gpuStartMs = timer.totalMs;
+		frames = 0;
+	}
+
+	void addFrame() { frames++; }
+
+	void print(const char* period, const GpuTimer& timer) const {
+		double wall = ovr_GetTimeInSeconds() - wallStart;
+		if (wall <= 0.0) { return; }
+		std::cout << std::noshowpos << std::fixed << std::setprecision(1) << period << ": " << wall << " s"
+			<< ", CPU " << (processCpuSeconds() - cpuStart) / wall * 100.0 << "% of a core"
+			<< ", eyes GPU " << (timer.totalMs - gpuStartMs) / (wall * 1000.0) * 100.0 << "%"
+			<< ", " << frames / wall << " frames/s" << std::endl;
+	}
+};
@@ -0,0 +1,910 @@
+#pragma once
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <shaderc/shaderc.h>
+#include <vulkan/vulkan.h>
+
+#include <Extras/OVR_Math.h>
+
+// Alternative renderer for the same fragment shaders, in Vulkan. Headless: each eye renders into an image of its own
+// and nothing is presented, so it also runs on a CPU implementation like Mesa's lavapipe. Shaders are built by
+// ShaderSource as for GL and compiled to SPIR-V by shaderc with the relaxed Vulkan rules, which pack the loose uniforms
+// into one uniform block and bind samplers automatically. Vulkan has no uniform initializers: they are stripped from
+// the source and their values written into the block instead.
+// Command buffers are recorded once per image slot and only submitted again, frames are paced with a timeline
+// semaphore. Only built with HELLOCULUS_VULKAN defined (see README).
+
+const static char* vulkanVertexSource = R"GLSL(
+#version 450
+void main() {
+    gl_Position = vec4(vec2((gl_VertexIndex << 1) & 2, gl_VertexIndex & 2) * 2.0 - 1.0, 0.0, 1.0);
+}
+)GLSL";
+
+struct UniformInitializer {
+	std::string type;
+	std::string name;
+	std::vector<double> values; // components, matrices column major
+};
+
+// Constant expressions the shaders initialize uniforms with: numbers, + - * /, parentheses and constructors
+struct InitializerParser {
+	const std::string& text;
+	size_t pos = 0;
+	bool ok = true;
+
+	explicit InitializerParser(const std::string& text) :
+		text(text) {
+	}
+
+	std::vector<double> parse() {
+		std::vector<double> v = expression();
+		skipSpaces();
+		if (pos != text.size()) { ok = false; }
+		return v;
+	}
+
+private:
+	void skipSpaces() {
+		while (pos < text.size() && std::isspace((unsigned char)text[pos])) { pos++; }
+	}
+
+	bool accept(char c) {
+		skipSpaces();
+		if (pos < text.size() && text[pos] == c) { pos++; return true; }
+		return false;
+	}
+
+	// component-wise, a scalar is applied to every component
+	std::vector<double> apply(const std::vector<double>& a, const std::vector<double>& b, char op) {
+		if (a.size() != b.size() && a.size() != 1 && b.size() != 1) { ok = false; return a; }
+		std::vector<double> r(std::max(a.size(), b.size()));
+		for (size_t i = 0; i < r.size(); i++) {
+			double x = a[a.size() == 1 ? 0 : i];
+			double y = b[b.size() == 1 ? 0 : i];
+			r[i] = op == '+' ? x + y : op == '-' ? x - y : op == '*' ? x * y : x / y;
+		}
+		return r;
+	}
+
+	std::vector<double> expression() {
+		std::vector<double> v = term();
+		for (;;) {
+			if (accept('+')) { v = apply(v, term(), '+'); }
+			else if (accept('-')) { v = apply(v, term(), '-'); }
+			else { return v; }
+		}
+	}
+
+	std::vector<double> term() {
+		std::vector<double> v = unary();
+		for (;;) {
+			if (accept('*')) { v = apply(v, unary(), '*'); }
+			else if (accept('/')) { v = apply(v, unary(), '/'); }
+			else { return v; }
+		}
+	}
+
+	std::vector<double> unary() {
+		if (accept('-')) { return apply({ 0.0 }, unary(), '-'); }
+		accept('+');
+		return primary();
+	}
+
+	std::vector<double> primary() {
+		skipSpaces();
+		if (accept('(')) {
+			std::vector<double> v = expression();
+			if (!accept(')')) { ok = false; }
+			return v;
+		}
+		if (pos < text.size() && (std::isdigit((unsigned char)text[pos]) || text[pos] == '.')) {
+			char* end = nullptr;
+			double value = std::strtod(text.c_str() + pos, &end);
+			pos = end - text.c_str();
+			if (pos < text.size() && std::strchr("fFuU", text[pos])) { pos++; }
+			return { value };
+		}
+		size_t start = pos;
+		while (pos < text.size() && (std::isalnum((unsigned char)text[pos]) || text[pos] == '_')) { pos++; }
+		std::string name = text.substr(start, pos - start);
+		if (name == "true") { return { 1.0 }; }
+		if (name == "false") { return { 0.0 }; }
+		if (name.empty() || !accept('(')) { ok = false; return { 0.0 }; }
+		std::vector<double> args;
+		if (!accept(')')) {
+			do {
+				std::vector<double> arg = expression();
+				args.insert(args.end(), arg.begin(), arg.end());
+			} while (accept(','));
+			if (!accept(')')) { ok = false; }
+		}
+		if (args.empty()) { ok = false; return { 0.0 }; }
+		return construct(name, args);
+	}
+
+	// vecN, ivecN, bvecN, matN and scalar constructors
+	std::vector<double> construct(const std::string& name, std::vector<double> args) {
+		size_t n = 1;
+		bool matrix = false;
+		size_t vec = name.find("vec");
+		if (vec != std::string::npos && vec + 4 == name.size()) { n = name[vec + 3] - '0'; }
+		else if (name.compare(0, 3, "mat") == 0 && name.size() == 4) { n = (name[3] - '0') * (name[3] - '0'); matrix = true; }
+		if (args.size() == 1 && n > 1) {
+			if (!matrix) { return std::vector<double>(n, args[0]); }
+			size_t columns = name[3] - '0';
+			std::vector<double> diagonal(n, 0.0);
+			for (size_t i = 0; i < columns; i++) { diagonal[i * columns + i] = args[0]; }
+			return diagonal;
+		}
+		if (name == "int") { args[0] = (double)(int)args[0]; }
+		args.resize(n, 0.0);
+		return args;
+	}
+};
+
+// Removes the initializers of "uniform TYPE NAME = VALUE;" lines, keeping the line count for compiler logs.
+// The values are returned in initializers when they could be evaluated.
+inline std::string stripUniformInitializers(const std::string& code, std::vector<UniformInitializer>& initializers) {
+	static const std::regex declaration(R"(^(\s*uniform\s+(\w+)\s+(\w+))\s*=\s*([^;]*);(.*)$)");
+	std::istringstream lines(code);
+	std::string line, stripped;
+	std::smatch match;
+	while (std::getline(lines, line)) {
+		if (std::regex_match(line, match, declaration)) {
+			std::string value = match[4].str();
+			InitializerParser parser(value);
+			UniformInitializer initializer = { match[2].str(), match[3].str(), parser.parse() };
+			if (parser.ok) { initializers.push_back(initializer); }
+			else { std::cout << "Can't evaluate the initializer of uniform " << initializer.name << ", it starts at 0" << std::endl; }
+			line = match[1].str() + ";" + match[5].str();
+		}
+		stripped += line + "\n";
+	}
+	return stripped;
+}
+
+// What the pipeline needs to know about a compiled fragment shader: where the default uniform block is bound and the
+// offsets of its members, and the binding of every sampler that is still used after optimization
+struct SpirvResources {
+	struct Member {
+		uint32_t offset = 0;
+		uint32_t matrixStride = 16;
+	};
+	struct Sampler {
+		uint32_t set = 0;
+		uint32_t binding = 0;
+		uint32_t dim = 1; // SPIR-V Dim: 1 for 2D, 2 for 3D, 5 for buffers
+		bool integer = false;
+	};
+	bool hasBlock = false;
+	uint32_t blockSet = 0;
+	uint32_t blockBinding = 0;
+	uint32_t blockSize = 0;
+	std::map<std::string, Member> members;
+	std::vector<Sampler> samplers;
+
+	bool parse(const std::vector<uint32_t>& words) {
+		enum : uint32_t {
+			OpMemberName = 6, OpTypeInt = 21, OpTypeImage = 25, OpTypeSampledImage = 27, OpTypePointer = 32,
+			OpVariable = 59, OpDecorate = 71, OpMemberDecorate = 72,
+			DecorationBlock = 2, DecorationMatrixStride = 7, DecorationBinding = 33, DecorationDescriptorSet = 34,
+			DecorationOffset = 35, StorageUniformConstant = 0, StorageUniform = 2
+		};
+		if (words.size() < 5 || words[0] != 0x07230203) { return false; }
+		typedef std::pair<uint32_t, uint32_t> TypeMember;
+		std::map<TypeMember, std::string> memberNames;
+		std::map<TypeMember, uint32_t> offsets, matrixStrides;
+		std::map<uint32_t, uint32_t> sets, bindings, sampledImages;
+		std::map<uint32_t, std::pair<uint32_t, uint32_t>> pointers, images; // storage class and type, sampled type and dim
+		std::set<uint32_t> blocks, intTypes;
+		std::vector<std::pair<uint32_t, uint32_t>> variables; // pointer type and id
+		for (size_t i = 5; i < words.size();) {
+			const uint32_t* w = &words[i];
+			uint32_t op = w[0] & 0xffff;
+			uint32_t count = w[0] >> 16;
+			if (count == 0 || i + count > words.size()) { return false; }
+			switch (op) {
+			case OpMemberName: memberNames[{ w[1], w[2] }] = (const char*)&w[3]; break;
+			case OpTypeInt: intTypes.insert(w[1]); break;
+			case OpTypeImage: images[w[1]] = { w[2], w[3] }; break;
+			case OpTypeSampledImage: sampledImages[w[1]] = w[2]; break;
+			case OpTypePointer: pointers[w[1]] = { w[2], w[3] }; break;
+			case OpVariable: variables.push_back({ w[1], w[2] }); break;
+			case OpDecorate:
+				if (w[2] == DecorationBlock) { blocks.insert(w[1]); }
+				if (w[2] == DecorationDescriptorSet) { sets[w[1]] = w[3]; }
+				if (w[2] == DecorationBinding) { bindings[w[1]] = w[3]; }
+				break;
+			case OpMemberDecorate:
+				if (w[3] == DecorationOffset) { offsets[{ w[1], w[2] }] = w[4]; }
+				if (w[3] == DecorationMatrixStride) { matrixStrides[{ w[1], w[2] }] = w[4]; }
+				break;
+			}
+			i += count;
+		}
+
+		for (const auto& variable : variables) {
+			auto pointer = pointers.find(variable.first);
+			if (pointer == pointers.end()) { continue; }
+			uint32_t storage = pointer->second.first;
+			uint32_t type = pointer->second.second;
+			if (storage == StorageUniform && blocks.count(type)) {
+				hasBlock = true;
+				blockSet = sets[variable.second];
+				blockBinding = bindings[variable.second];
+				for (const auto& name : memberNames) {
+					if (name.first.first != type) { continue; }
+					Member member;
+					member.offset = offsets[name.first];
+					if (matrixStrides.count(name.first)) { member.matrixStride = matrixStrides[name.first]; }
+					members[name.second] = member;
+					// room for the largest member type, a mat4 or a vec2[4]
+					blockSize = std::max(blockSize, member.offset + 64);
+				}
+			}
+			else if (storage == StorageUniformConstant && sampledImages.count(type)) {
+				const auto& image = images[sampledImages[type]];
+				Sampler sampler;
+				sampler.set = sets[variable.second];
+				sampler.binding = bindings[variable.second];
+				sampler.dim = image.second;
+				sampler.integer = intTypes.count(image.first) > 0;
+				samplers.push_back(sampler);
+			}
+		}
+		return true;
+	}
+};
+
+struct VulkanBackend {
+	static const int slots = 3; // images per eye in flight, as in a swap chain
+	struct Image {
+		VkImage image = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkImageView view = VK_NULL_HANDLE;
+		VkFramebuffer framebuffer = VK_NULL_HANDLE;
+	};
+	OVR::Sizei size;
+	bool preferCpu = false; // picks a CPU implementation such as lavapipe when there's one
+	VkInstance instance = VK_NULL_HANDLE;
+	VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+	VkPhysicalDeviceProperties properties = {};
+	VkDevice device = VK_NULL_HANDLE;
+	uint32_t queueFamily = 0;
+	VkQueue queue = VK_NULL_HANDLE;
+	VkCommandPool commandPool = VK_NULL_HANDLE;
+	VkRenderPass renderPass = VK_NULL_HANDLE;
+	VkSemaphore timeline = VK_NULL_HANDLE;
+	uint64_t submitted = 0; // value of the timeline semaphore once every submitted frame is done
+	Image eyeImages[slots][2];
+	VkCommandBuffer commandBuffers[slots] = {};
+
+	// the loaded shader
+	SpirvResources resources;
+	std::vector<UniformInitializer> initializers;
+	VkShaderModule modules[2] = { VK_NULL_HANDLE, VK_NULL_HANDLE };
+	VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+	VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+	VkPipeline pipeline = VK_NULL_HANDLE;
+	VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+	VkDescriptorSet sets[slots][2] = {};
+	VkBuffer uniformBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory uniformMemory = VK_NULL_HANDLE;
+	uint8_t* uniformData = nullptr;
+	VkDeviceSize uniformStride = 0;
+
+	// Vulkan needs something bound to every sampler, the app's textures aren't uploaded here so they all read 0
+	Image dummyImages[2]; // 2D and 3D
+	VkBuffer dummyBuffer = VK_NULL_HANDLE;
+	VkDeviceMemory dummyBufferMemory = VK_NULL_HANDLE;
+	VkBufferView dummyBufferViews[2] = { VK_NULL_HANDLE, VK_NULL_HANDLE }; // float and integer
+	VkSampler sampler = VK_NULL_HANDLE;
+
+	explicit VulkanBackend(OVR::Sizei size) :
+		size(size) {
+	}
+
+	~VulkanBackend() {
+		if (device) {
+			vkDeviceWaitIdle(device);
+			vkDestroySampler(device, sampler, nullptr);
+			for (VkBufferView view : dummyBufferViews) { vkDestroyBufferView(device, view, nullptr); }
+			vkDestroyBuffer(device, dummyBuffer, nullptr);
+			vkFreeMemory(device, dummyBufferMemory, nullptr);
+			for (Image& image : dummyImages) { destroyImage(image); }
+			vkDestroyBuffer(device, uniformBuffer, nullptr);
+			vkFreeMemory(device, uniformMemory, nullptr);
+			vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+			vkDestroyPipeline(device, pipeline, nullptr);
+			vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+			vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+			for (VkShaderModule module : modules) { vkDestroyShaderModule(device, module, nullptr); }
+			for (int slot = 0; slot < slots; slot++) {
+				for (int eye = 0; eye < 2; eye++) { destroyImage(eyeImages[slot][eye]); }
+			}
+			vkDestroySemaphore(device, timeline, nullptr);
+			vkDestroyRenderPass(device, renderPass, nullptr);
+			vkDestroyCommandPool(device, commandPool, nullptr);
+			vkDestroyDevice(device, nullptr);
+		}
+		if (instance) { vkDestroyInstance(instance, nullptr); }
+	}
+
+	// Device, eye images and frame pacing. Returns false when there's no usable Vulkan 1.2 device.
+	bool init() {
+		VkApplicationInfo app = { VK_STRUCTURE_TYPE_APPLICATION_INFO };
+		app.pApplicationName = "HelloCulus";
+		app.apiVersion = VK_API_VERSION_1_2;
+		VkInstanceCreateInfo instanceInfo = { VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO };
+		instanceInfo.pApplicationInfo = &app;
+		if (!check(vkCreateInstance(&instanceInfo, nullptr, &instance), "vkCreateInstance")) { return false; }
+
+		uint32_t count = 0;
+		vkEnumeratePhysicalDevices(instance, &count, nullptr);
+		std::vector<VkPhysicalDevice> devices(count);
+		vkEnumeratePhysicalDevices(instance, &count, devices.data());
+		for (VkPhysicalDevice candidate : devices) {
+			VkPhysicalDeviceProperties p;
+			vkGetPhysicalDeviceProperties(candidate, &p);
+			if (p.apiVersion < VK_API_VERSION_1_2) { continue; }
+			bool cpu = p.deviceType == VK_PHYSICAL_DEVICE_TYPE_CPU;
+			if (!physicalDevice || (preferCpu && cpu && properties.deviceType != VK_PHYSICAL_DEVICE_TYPE_CPU)) {
+				physicalDevice = candidate;
+				properties = p;
+			}
+		}
+		if (!physicalDevice) { std::cout << "No Vulkan 1.2 device" << std::endl; return false; }
+		std::cout << "Vulkan device: " << properties.deviceName << std::endl;
+
+		VkPhysicalDeviceVulkan12Features supported12 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+		VkPhysicalDeviceFeatures2 supported = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2 };
+		supported.pNext = &supported12;
+		vkGetPhysicalDeviceFeatures2(physicalDevice, &supported);
+		if (!supported12.timelineSemaphore) { std::cout << "No timeline semaphores on " << properties.deviceName << std::endl; return false; }
+
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, nullptr);
+		std::vector<VkQueueFamilyProperties> families(count);
+		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &count, families.data());
+		for (queueFamily = 0; queueFamily < count; queueFamily++) {
+			if (families[queueFamily].queueFlags & VK_QUEUE_GRAPHICS_BIT) { break; }
+		}
+		if (queueFamily == count) { std::cout << "No graphics queue on " << properties.deviceName << std::endl; return false; }
+
+		float priority = 1.0f;
+		VkDeviceQueueCreateInfo queueInfo = { VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO };
+		queueInfo.queueFamilyIndex = queueFamily;
+		queueInfo.queueCount = 1;
+		queueInfo.pQueuePriorities = &priority;
+		VkPhysicalDeviceVulkan12Features enabled12 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES };
+		enabled12.timelineSemaphore = VK_TRUE;
+		VkDeviceCreateInfo deviceInfo = { VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO };
+		deviceInfo.pNext = &enabled12;
+		deviceInfo.queueCreateInfoCount = 1;
+		deviceInfo.pQueueCreateInfos = &queueInfo;
+		if (!check(vkCreateDevice(physicalDevice, &deviceInfo, nullptr, &device), "vkCreateDevice")) { return false; }
+		vkGetDeviceQueue(device, queueFamily, 0, &queue);
+
+		VkCommandPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO };
+		poolInfo.queueFamilyIndex = queueFamily;
+		if (!check(vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool), "vkCreateCommandPool")) { return false; }
+
+		VkSemaphoreTypeCreateInfo typeInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO };
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		VkSemaphoreCreateInfo semaphoreInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
+		semaphoreInfo.pNext = &typeInfo;
+		if (!check(vkCreateSemaphore(device, &semaphoreInfo, nullptr, &timeline), "vkCreateSemaphore")) { return false; }
+
+		// Every pixel gets shaded, nothing to load. Left ready for reading back.
+		VkAttachmentDescription attachment = {};
+		attachment.format = VK_FORMAT_R8G8B8A8_UNORM;
+		attachment.samples = VK_SAMPLE_COUNT_1_BIT;
+		attachment.loadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+		attachment.stencilLoadOp = VK_ATTACHMENT_LOAD_OP_DONT_CARE;
+		attachment.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
+		attachment.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		attachment.finalLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		VkAttachmentReference colorRef = { 0, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL };
+		VkSubpassDescription subpass = {};
+		subpass.pipelineBindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+		subpass.colorAttachmentCount = 1;
+		subpass.pColorAttachments = &colorRef;
+		VkSubpassDependency dependencies[2] = {};
+		dependencies[0].srcSubpass = VK_SUBPASS_EXTERNAL; // after an earlier read back of the image
+		dependencies[0].dstSubpass = 0;
+		dependencies[0].srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependencies[0].dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[0].dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].srcSubpass = 0; // before reading it back
+		dependencies[1].dstSubpass = VK_SUBPASS_EXTERNAL;
+		dependencies[1].srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+		dependencies[1].srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT;
+		dependencies[1].dstStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT;
+		dependencies[1].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		VkRenderPassCreateInfo passInfo = { VK_STRUCTURE_TYPE_RENDER_PASS_CREATE_INFO };
+		passInfo.attachmentCount = 1;
+		passInfo.pAttachments = &attachment;
+		passInfo.subpassCount = 1;
+		passInfo.pSubpasses = &subpass;
+		passInfo.dependencyCount = 2;
+		passInfo.pDependencies = dependencies;
+		if (!check(vkCreateRenderPass(device, &passInfo, nullptr, &renderPass), "vkCreateRenderPass")) { return false; }
+
+		for (int slot = 0; slot < slots; slot++) {
+			for (int eye = 0; eye < 2; eye++) {
+				Image& image = eyeImages[slot][eye];
+				VkExtent3D extent = { (uint32_t)size.w, (uint32_t)size.h, 1 };
+				if (!createImage(image, VK_IMAGE_TYPE_2D, extent, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT)) { return false; }
+				VkFramebufferCreateInfo framebufferInfo = { VK_STRUCTURE_TYPE_FRAMEBUFFER_CREATE_INFO };
+				framebufferInfo.renderPass = renderPass;
+				framebufferInfo.attachmentCount = 1;
+				framebufferInfo.pAttachments = &image.view;
+				framebufferInfo.width = size.w;
+				framebufferInfo.height = size.h;
+				framebufferInfo.layers = 1;
+				if (!check(vkCreateFramebuffer(device, &framebufferInfo, nullptr, &image.framebuffer), "vkCreateFramebuffer")) { return false; }
+			}
+		}
+		return true;
+	}
+
+	// Compiles the built fragment shader, sets up its pipeline and descriptors, and records the command buffers.
+	bool load(const std::string& fragmentCode, const std::string& name) {
+		std::string code = stripUniformInitializers(fragmentCode, initializers);
+		std::vector<uint32_t> vertexSpirv, fragmentSpirv;
+		if (!compile(vulkanVertexSource, shaderc_vertex_shader, "fullscreen", vertexSpirv)) { return false; }
+		if (!compile(code, shaderc_fragment_shader, name, fragmentSpirv)) { return false; }
+		if (!resources.parse(fragmentSpirv)) { std::cout << "Unexpected SPIR-V from shaderc" << std::endl; return false; }
+		// automatic bindings all go to set 0
+		for (const SpirvResources::Sampler& s : resources.samplers) {
+			if (s.set != 0 || (resources.hasBlock && resources.blockSet != 0)) { std::cout << "Only descriptor set 0 is supported" << std::endl; return false; }
+		}
+		if (!createModule(vertexSpirv, modules[0]) || !createModule(fragmentSpirv, modules[1])) { return false; }
+		if (!createDummies() || !createPipeline() || !createDescriptors()) { return false; }
+		record();
+		return true;
+	}
+
+	void setFloats(int slot, int eye, const std::string& name, const std::vector<float>& values) {
+		auto member = resources.members.find(name);
+		if (member == resources.members.end()) { return; } // optimized out
+		uint8_t* block = uniformData + (slot * 2 + eye) * uniformStride;
+		memcpy(block + member->second.offset, values.data(), values.size() * sizeof(float));
+	}
+
+	void setInts(int slot, int eye, const std::string& name, const std::vector<int32_t>& values) {
+		auto member = resources.members.find(name);
+		if (member == resources.members.end()) { return; }
+		uint8_t* block = uniformData + (slot * 2 + eye) * uniformStride;
+		memcpy(block + member->second.offset, values.data(), values.size() * sizeof(int32_t));
+	}
+
+	// Sets the uniform in every slot and eye
+	void setFloats(const std::string& name, const std::vector<float>& values) {
+		for (int slot = 0; slot < slots; slot++) {
+			for (int eye = 0; eye < 2; eye++) { setFloats(slot, eye, name, values); }
+		}
+	}
+
+	// Submits frames, both eyes each. A slot's command buffer and uniforms are reused once the timeline semaphore says
+	// its previous frame is done. Returns frames per second, with the average CPU time per frame spent updating uniforms
+	// and submitting in submitMs.
+	double run(int frames, double& submitMs) {
+		double submitTotal = 0.0;
+		auto begin = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frames; frame++) {
+			int slot = (int)(submitted % slots);
+			if (submitted >= slots) { wait(submitted + 1 - slots); }
+			auto submitBegin = std::chrono::steady_clock::now();
+			for (int eye = 0; eye < 2; eye++) { setFloats(slot, eye, "time", { frame / 90.0f }); }
+			uint64_t signalValue = ++submitted;
+			VkTimelineSemaphoreSubmitInfo timelineInfo = { VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO };
+			timelineInfo.signalSemaphoreValueCount = 1;
+			timelineInfo.pSignalSemaphoreValues = &signalValue;
+			VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+			submit.pNext = &timelineInfo;
+			submit.commandBufferCount = 1;
+			submit.pCommandBuffers = &commandBuffers[slot];
+			submit.signalSemaphoreCount = 1;
+			submit.pSignalSemaphores = &timeline;
+			vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE);
+			submitTotal += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - submitBegin).count();
+		}
+		wait(submitted);
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		submitMs = submitTotal / frames;
+		return frames / seconds;
+	}
+
+	// Left eye of the last frame as RGB, rows from the bottom like glReadPixels: Vulkan's gl_FragCoord starts at the
+	// top, so the same rows end up at the same place in memory.
+	void readPixels(std::vector<unsigned char>& pixels) {
+		wait(submitted);
+		const Image& image = eyeImages[(submitted + slots - 1) % slots][0];
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize bytes = (VkDeviceSize)size.w * size.h * 4;
+		if (!createBuffer(bytes, VK_BUFFER_USAGE_TRANSFER_DST_BIT, buffer, memory)) { return; }
+		submitOnce([&](VkCommandBuffer commandBuffer) {
+			VkBufferImageCopy region = {};
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 };
+			region.imageExtent = { (uint32_t)size.w, (uint32_t)size.h, 1 };
+			vkCmdCopyImageToBuffer(commandBuffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, buffer, 1, &region);
+		});
+		void* data = nullptr;
+		vkMapMemory(device, memory, 0, bytes, 0, &data);
+		const unsigned char* rgba = (const unsigned char*)data;
+		pixels.resize(size.w * size.h * 3);
+		for (int i = 0; i < size.w * size.h; i++) {
+			for (int c = 0; c < 3; c++) { pixels[i * 3 + c] = rgba[i * 4 + c]; }
+		}
+		vkUnmapMemory(device, memory);
+		vkDestroyBuffer(device, buffer, nullptr);
+		vkFreeMemory(device, memory, nullptr);
+	}
+
+private:
+	static bool check(VkResult result, const char* what) {
+		if (result != VK_SUCCESS) { std::cout << what << " failed with " << result << std::endl; }
+		return result == VK_SUCCESS;
+	}
+
+	void wait(uint64_t value) {
+		VkSemaphoreWaitInfo waitInfo = { VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO };
+		waitInfo.semaphoreCount = 1;
+		waitInfo.pSemaphores = &timeline;
+		waitInfo.pValues = &value;
+		vkWaitSemaphores(device, &waitInfo, UINT64_MAX);
+	}
+
+	bool compile(const std::string& code, shaderc_shader_kind kind, const std::string& name, std::vector<uint32_t>& spirv) {
+		shaderc_compiler_t compiler = shaderc_compiler_initialize();
+		shaderc_compile_options_t options = shaderc_compile_options_initialize();
+		shaderc_compile_options_set_target_env(options, shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
+		shaderc_compile_options_set_vulkan_rules_relaxed(options, true);
+		shaderc_compile_options_set_auto_bind_uniforms(options, true);
+		shaderc_compile_options_set_auto_map_locations(options, true);
+		// drops unused samplers, so that only the ones the shader reads need descriptors
+		shaderc_compile_options_set_optimization_level(options, shaderc_optimization_level_performance);
+		shaderc_compilation_result_t result = shaderc_compile_into_spv(compiler, code.c_str(), code.size(), kind, name.c_str(), "main", options);
+		bool ok = shaderc_result_get_compilation_status(result) == shaderc_compilation_status_success;
+		if (!ok) { std::cout << "Log: " << shaderc_result_get_error_message(result) << std::endl; }
+		else {
+			const uint32_t* words = (const uint32_t*)shaderc_result_get_bytes(result);
+			spirv.assign(words, words + shaderc_result_get_length(result) / sizeof(uint32_t));
+		}
+		shaderc_result_release(result);
+		shaderc_compile_options_release(options);
+		shaderc_compiler_release(compiler);
+		return ok;
+	}
+
+	bool createModule(const std::vector<uint32_t>& spirv, VkShaderModule& module) {
+		VkShaderModuleCreateInfo info = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
+		info.codeSize = spirv.size() * sizeof(uint32_t);
+		info.pCode = spirv.data();
+		return check(vkCreateShaderModule(device, &info, nullptr, &module), "vkCreateShaderModule");
+	}
+
+	bool allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags flags, VkDeviceMemory& memory) {
+		VkPhysicalDeviceMemoryProperties memoryProperties;
+		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+			if (!(requirements.memoryTypeBits & (1u << i)) || (memoryProperties.memoryTypes[i].propertyFlags & flags) != flags) { continue; }
+			VkMemoryAllocateInfo info = { VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO };
+			info.allocationSize = requirements.size;
+			info.memoryTypeIndex = i;
+			return check(vkAllocateMemory(device, &info, nullptr, &memory), "vkAllocateMemory");
+		}
+		std::cout << "No suitable Vulkan memory type" << std::endl;
+		return false;
+	}
+
+	// host visible and coherent, for uniforms and read back
+	bool createBuffer(VkDeviceSize bytes, VkBufferUsageFlags usage, VkBuffer& buffer, VkDeviceMemory& memory) {
+		VkBufferCreateInfo info = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+		info.size = bytes;
+		info.usage = usage;
+		if (!check(vkCreateBuffer(device, &info, nullptr, &buffer), "vkCreateBuffer")) { return false; }
+		VkMemoryRequirements requirements;
+		vkGetBufferMemoryRequirements(device, buffer, &requirements);
+		if (!allocate(requirements, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, memory)) { return false; }
+		return check(vkBindBufferMemory(device, buffer, memory, 0), "vkBindBufferMemory");
+	}
+
+	bool createImage(Image& image, VkImageType type, VkExtent3D extent, VkImageUsageFlags usage) {
+		VkImageCreateInfo info = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+		info.imageType = type;
+		info.format = VK_FORMAT_R8G8B8A8_UNORM;
+		info.extent = extent;
+		info.mipLevels = 1;
+		info.arrayLayers = 1;
+		info.samples = VK_SAMPLE_COUNT_1_BIT;
+		info.tiling = VK_IMAGE_TILING_OPTIMAL;
+		info.usage = usage;
+		info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+		if (!check(vkCreateImage(device, &info, nullptr, &image.image), "vkCreateImage")) { return false; }
+		VkMemoryRequirements requirements;
+		vkGetImageMemoryRequirements(device, image.image, &requirements);
+		if (!allocate(requirements, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image.memory)) { return false; }
+		if (!check(vkBindImageMemory(device, image.image, image.memory, 0), "vkBindImageMemory")) { return false; }
+		VkImageViewCreateInfo viewInfo = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+		viewInfo.image = image.image;
+		viewInfo.viewType = type == VK_IMAGE_TYPE_3D ? VK_IMAGE_VIEW_TYPE_3D : VK_IMAGE_VIEW_TYPE_2D;
+		viewInfo.format = info.format;
+		viewInfo.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+		return check(vkCreateImageView(device, &viewInfo, nullptr, &image.view), "vkCreateImageView");
+	}
+
+	void destroyImage(Image& image) {
+		vkDestroyFramebuffer(device, image.framebuffer, nullptr);
+		vkDestroyImageView(device, image.view, nullptr);
+		vkDestroyImage(device, image.image, nullptr);
+		vkFreeMemory(device, image.memory, nullptr);
+		image = Image();
+	}
+
+	void submitOnce(const std::function<void(VkCommandBuffer)>& commands) {
+		VkCommandBufferAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+		allocateInfo.commandPool = commandPool;
+		allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocateInfo.commandBufferCount = 1;
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		vkAllocateCommandBuffers(device, &allocateInfo, &commandBuffer);
+		VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		vkBeginCommandBuffer(commandBuffer, &beginInfo);
+		commands(commandBuffer);
+		vkEndCommandBuffer(commandBuffer);
+		VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+		submit.commandBufferCount = 1;
+		submit.pCommandBuffers = &commandBuffer;
+		vkQueueSubmit(queue, 1, &submit, VK_NULL_HANDLE);
+		vkQueueWaitIdle(queue);
+		vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+	}
+
+	// 1x1 black images and a zeroed texel buffer
+	bool createDummies() {
+		const VkImageUsageFlags usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT;
+		if (!createImage(dummyImages[0], VK_IMAGE_TYPE_2D, { 1, 1, 1 }, usage)) { return false; }
+		if (!createImage(dummyImages[1], VK_IMAGE_TYPE_3D, { 1, 1, 1 }, usage)) { return false; }
+		submitOnce([&](VkCommandBuffer commandBuffer) {
+			for (const Image& image : dummyImages) {
+				VkImageMemoryBarrier barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
+				barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+				barrier.image = image.image;
+				barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 };
+				barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+				barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+				VkClearColorValue black = {};
+				vkCmdClearColorImage(commandBuffer, image.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, &black, 1, &barrier.subresourceRange);
+				barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+				barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+				barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+				barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+				vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+			}
+		});
+
+		const VkDeviceSize bytes = 16;
+		if (!createBuffer(bytes, VK_BUFFER_USAGE_UNIFORM_TEXEL_BUFFER_BIT, dummyBuffer, dummyBufferMemory)) { return false; }
+		void* data = nullptr;
+		vkMapMemory(device, dummyBufferMemory, 0, bytes, 0, &data);
+		memset(data, 0, (size_t)bytes);
+		vkUnmapMemory(device, dummyBufferMemory);
+		const VkFormat formats[2] = { VK_FORMAT_R32G32B32A32_SFLOAT, VK_FORMAT_R32G32B32A32_SINT };
+		for (int i = 0; i < 2; i++) {
+			VkBufferViewCreateInfo viewInfo = { VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO };
+			viewInfo.buffer = dummyBuffer;
+			viewInfo.format = formats[i];
+			viewInfo.range = VK_WHOLE_SIZE;
+			if (!check(vkCreateBufferView(device, &viewInfo, nullptr, &dummyBufferViews[i]), "vkCreateBufferView")) { return false; }
+		}
+
+		VkSamplerCreateInfo samplerInfo = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+		samplerInfo.magFilter = VK_FILTER_NEAREST;
+		samplerInfo.minFilter = VK_FILTER_NEAREST;
+		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		return check(vkCreateSampler(device, &samplerInfo, nullptr, &sampler), "vkCreateSampler");
+	}
+
+	bool createPipeline() {
+		std::vector<VkDescriptorSetLayoutBinding> bindings;
+		if (resources.hasBlock) {
+			bindings.push_back({ resources.blockBinding, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr });
+		}
+		for (const SpirvResources::Sampler& s : resources.samplers) {
+			VkDescriptorType type = s.dim == 5 ? VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER : VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+			bindings.push_back({ s.binding, type, 1, VK_SHADER_STAGE_FRAGMENT_BIT, nullptr });
+		}
+		VkDescriptorSetLayoutCreateInfo setInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+		setInfo.bindingCount = (uint32_t)bindings.size();
+		setInfo.pBindings = bindings.data();
+		if (!check(vkCreateDescriptorSetLayout(device, &setInfo, nullptr, &setLayout), "vkCreateDescriptorSetLayout")) { return false; }
+		VkPipelineLayoutCreateInfo layoutInfo = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+		layoutInfo.setLayoutCount = 1;
+		layoutInfo.pSetLayouts = &setLayout;
+		if (!check(vkCreatePipelineLayout(device, &layoutInfo, nullptr, &pipelineLayout), "vkCreatePipelineLayout")) { return false; }
+
+		VkPipelineShaderStageCreateInfo stages[2] = {};
+		for (int i = 0; i < 2; i++) {
+			stages[i].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+			stages[i].stage = i == 0 ? VK_SHADER_STAGE_VERTEX_BIT : VK_SHADER_STAGE_FRAGMENT_BIT;
+			stages[i].module = modules[i];
+			stages[i].pName = "main";
+		}
+		VkPipelineVertexInputStateCreateInfo vertexInput = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO };
+		VkPipelineInputAssemblyStateCreateInfo assembly = { VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO };
+		assembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+		VkViewport viewport = { 0.0f, 0.0f, (float)size.w, (float)size.h, 0.0f, 1.0f };
+		VkRect2D scissor = { { 0, 0 }, { (uint32_t)size.w, (uint32_t)size.h } };
+		VkPipelineViewportStateCreateInfo viewportState = { VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO };
+		viewportState.viewportCount = 1;
+		viewportState.pViewports = &viewport;
+		viewportState.scissorCount = 1;
+		viewportState.pScissors = &scissor;
+		VkPipelineRasterizationStateCreateInfo rasterization = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
+		rasterization.polygonMode = VK_POLYGON_MODE_FILL;
+		rasterization.cullMode = VK_CULL_MODE_NONE;
+		rasterization.lineWidth = 1.0f;
+		VkPipelineMultisampleStateCreateInfo multisample = { VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
+		multisample.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+		VkPipelineColorBlendAttachmentState blendAttachment = {};
+		blendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+		VkPipelineColorBlendStateCreateInfo blend = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
+		blend.attachmentCount = 1;
+		blend.pAttachments = &blendAttachment;
+		VkGraphicsPipelineCreateInfo info = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
+		info.stageCount = 2;
+		info.pStages = stages;
+		info.pVertexInputState = &vertexInput;
+		info.pInputAssemblyState = &assembly;
+		info.pViewportState = &viewportState;
+		info.pRasterizationState = &rasterization;
+		info.pMultisampleState = &multisample;
+		info.pColorBlendState = &blend;
+		info.layout = pipelineLayout;
+		info.renderPass = renderPass;
+		return check(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &info, nullptr, &pipeline), "vkCreateGraphicsPipelines");
+	}
+
+	// A set and a uniform block per slot and eye, filled with the stripped initializers' values
+	bool createDescriptors() {
+		VkDeviceSize alignment = std::max<VkDeviceSize>(properties.limits.minUniformBufferOffsetAlignment, 16);
+		uniformStride = (std::max<VkDeviceSize>(resources.blockSize, 16) + alignment - 1) / alignment * alignment;
+		if (!createBuffer(uniformStride * slots * 2, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, uniformBuffer, uniformMemory)) { return false; }
+		vkMapMemory(device, uniformMemory, 0, VK_WHOLE_SIZE, 0, (void**)&uniformData);
+		memset(uniformData, 0, (size_t)(uniformStride * slots * 2));
+		for (int slot = 0; slot < slots; slot++) {
+			for (int eye = 0; eye < 2; eye++) {
+				for (const UniformInitializer& u : initializers) { writeInitializer(slot, eye, u); }
+				setInts(slot, eye, "eyeNo", { eye });
+			}
+		}
+
+		uint32_t imageCount = 0, bufferCount = 0;
+		for (const SpirvResources::Sampler& s : resources.samplers) { (s.dim == 5 ? bufferCount : imageCount)++; }
+		std::vector<VkDescriptorPoolSize> poolSizes = { { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, slots * 2 } };
+		if (imageCount) { poolSizes.push_back({ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, imageCount * slots * 2 }); }
+		if (bufferCount) { poolSizes.push_back({ VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, bufferCount * slots * 2 }); }
+		VkDescriptorPoolCreateInfo poolInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+		poolInfo.maxSets = slots * 2;
+		poolInfo.poolSizeCount = (uint32_t)poolSizes.size();
+		poolInfo.pPoolSizes = poolSizes.data();
+		if (!check(vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool), "vkCreateDescriptorPool")) { return false; }
+
+		std::vector<VkDescriptorSetLayout> layouts(slots * 2, setLayout);
+		VkDescriptorSetAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+		allocateInfo.descriptorPool = descriptorPool;
+		allocateInfo.descriptorSetCount = slots * 2;
+		allocateInfo.pSetLayouts = layouts.data();
+		if (!check(vkAllocateDescriptorSets(device, &allocateInfo, &sets[0][0]), "vkAllocateDescriptorSets")) { return false; }
+
+		VkDescriptorImageInfo imageInfos[2];
+		for (int i = 0; i < 2; i++) { imageInfos[i] = { sampler, dummyImages[i].view, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL }; }
+		for (int slot = 0; slot < slots; slot++) {
+			for (int eye = 0; eye < 2; eye++) {
+				VkDescriptorBufferInfo bufferInfo = { uniformBuffer, (slot * 2 + eye) * uniformStride, uniformStride };
+				std::vector<VkWriteDescriptorSet> writes;
+				VkWriteDescriptorSet write = { VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+				write.dstSet = sets[slot][eye];
+				write.descriptorCount = 1;
+				if (resources.hasBlock) {
+					write.dstBinding = resources.blockBinding;
+					write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
+					write.pBufferInfo = &bufferInfo;
+					writes.push_back(write);
+				}
+				for (const SpirvResources::Sampler& s : resources.samplers) {
+					VkWriteDescriptorSet samplerWrite = write;
+					samplerWrite.dstBinding = s.binding;
+					samplerWrite.pBufferInfo = nullptr;
+					if (s.dim == 5) {
+						samplerWrite.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER;
+						samplerWrite.pTexelBufferView = &dummyBufferViews[s.integer ? 1 : 0];
+					}
+					else {
+						samplerWrite.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+						samplerWrite.pImageInfo = &imageInfos[s.dim == 2 ? 1 : 0];
+					}
+					writes.push_back(samplerWrite);
+				}
+				vkUpdateDescriptorSets(device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+			}
+		}
+		return true;
+	}
+
+	void writeInitializer(int slot, int eye, const UniformInitializer& u) {
+		auto member = resources.members.find(u.name);
+		if (member == resources.members.end()) { return; }
+		uint8_t* block = uniformData + (slot * 2 + eye) * uniformStride + member->second.offset;
+		if (u.type.compare(0, 3, "mat") == 0) {
+			size_t columns = u.type[3] - '0';
+			for (size_t c = 0; c < columns; c++) {
+				for (size_t r = 0; r < columns; r++) {
+					float value = (float)u.values[c * columns + r];
+					memcpy(block + c * member->second.matrixStride + r * sizeof(float), &value, sizeof(float));
+				}
+			}
+		}
+		else if (u.type[0] == 'i' || u.type[0] == 'u' || u.type[0] == 'b') {
+			for (size_t i = 0; i < u.values.size(); i++) {
+				int32_t value = (int32_t)u.values[i];
+				memcpy(block + i * sizeof(int32_t), &value, sizeof(int32_t));
+			}
+		}
+		else {
+			for (size_t i = 0; i < u.values.size(); i++) {
+				float value = (float)u.values[i];
+				memcpy(block + i * sizeof(float), &value, sizeof(float));
+			}
+		}
+	}
+
+	// Both eyes of a slot, recorded once: per frame only the slot's uniforms change
+	void record() {
+		VkCommandBufferAllocateInfo allocateInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+		allocateInfo.commandPool = commandPool;
+		allocateInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+		allocateInfo.commandBufferCount = slots;
+		vkAllocateCommandBuffers(device, &allocateInfo, commandBuffers);
+		for (int slot = 0; slot < slots; slot++) {
+			VkCommandBufferBeginInfo beginInfo = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+			vkBeginCommandBuffer(commandBuffers[slot], &beginInfo);
+			for (int eye = 0; eye < 2; eye++) {
+				VkRenderPassBeginInfo passBegin = { VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO };
+				passBegin.renderPass = renderPass;
+				passBegin.framebuffer = eyeImages[slot][eye].framebuffer;
+				passBegin.renderArea = { { 0, 0 }, { (uint32_t)size.w, (uint32_t)size.h } };
+				vkCmdBeginRenderPass(commandBuffers[slot], &passBegin, VK_SUBPASS_CONTENTS_INLINE);
+				vkCmdBindPipeline(commandBuffers[slot], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+				vkCmdBindDescriptorSets(commandBuffers[slot], VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &sets[slot][eye], 0, nullptr);
+				vkCmdDraw(commandBuffers[slot], 3, 1, 0, 0);
+				vkCmdEndRenderPass(commandBuffers[slot]);
+			}
+			vkEndCommandBuffer(commandBuffers[slot]);
+		}
+	}
+};
@@ -0,0 +1,94 @@
+#pragma once
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include <glad/glad.h>
+
+#include <Extras/OVR_Math.h>
+
+#include "FullscreenTriangle.h"
+#include "GlState.h"
+#include "NoiseLibrary.h"
+#include "QualitySweep.h"
+#include "ShaderSource.h"
+#include "VulkanBackend.h"
+
+// Offscreen comparison of the GL renderer with the Vulkan one (see VulkanBackend.h) on a shader. Both render two eyes
+// per frame for the same number of frames, without waiting for each frame. Printed per API: the CPU time per frame spent
+// issuing the work and the frame throughput. The PSNR between their images checks that both render the same thing.
+// With --vulkan-cpu a CPU implementation such as lavapipe is picked, to compare the APIs' CPU overhead without a GPU.
+struct VulkanBenchmark {
+	int frames = 200;
+	OVR::Sizei size;
+	QualitySweep renderer; // GL target, fixed camera and reference image
+	VulkanBackend vulkan;
+
+	VulkanBenchmark(OVR::Sizei size, int timedFrames, const NoiseLibrary* noise) :
+		size(size),
+		renderer(size, timedFrames),
+		vulkan(size) {
+		renderer.noise = noise;
+	}
+
+	// Same frame loop as VulkanBackend::run, on the camera QualitySweep::render left set
+	double runGl(GLuint programId, double& submitMs) {
+		glState().bindFramebuffer(renderer.fboId);
+		glState().viewport(0, 0, size.w, size.h);
+		glFinish();
+		double submitTotal = 0.0;
+		auto begin = std::chrono::steady_clock::now();
+		for (int frame = 0; frame < frames; frame++) {
+			auto submitBegin = std::chrono::steady_clock::now();
+			glProgramUniform1f(programId, glGetUniformLocation(programId, "time"), frame / 90.0f);
+			for (int eye = 0; eye < 2; eye++) {
+				glProgramUniform1i(programId, glGetUniformLocation(programId, "eyeNo"), eye);
+				fullscreen().draw(programId);
+			}
+			glFlush();
+			submitTotal += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - submitBegin).count();
+		}
+		glFinish();
+		double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+		glState().bindFramebuffer(0);
+		submitMs = submitTotal / frames;
+		return frames / seconds;
+	}
+
+	int run(const std::string& filepath) {
+		ShaderSource source;
+		if (!source.load(filepath)) { return EXIT_FAILURE; }
+		std::string code = source.build({});
+		GLuint programId = linkFragmentProgram(code);
+		if (!programId) { return EXIT_FAILURE; }
+		if (!vulkan.init() || !vulkan.load(code, filepath)) { glDeleteProgram(programId); return EXIT_FAILURE; }
+
+		// the camera of the GL reference image, at time 0
+		const float tanX = 1.0f;
+		const float tanY = tanX * size.h / size.w;
+		vulkan.setFloats("resolution", { (float)size.w, (float)size.h });
+		vulkan.setFloats("rayCorner", { -tanX, -tanY, -1.0f });
+		vulkan.setFloats("rayDx", { 2.0f * tanX / size.w, 0.0f, 0.0f });
+		vulkan.setFloats("rayDy", { 0.0f, 2.0f * tanY / size.h, 0.0f });
+		std::vector<unsigned char> glPixels, vulkanPixels;
+		double glGpuMs = renderer.render(programId, glPixels);
+		double unused = 0.0;
+		vulkan.run(1, unused);
+		vulkan.readPixels(vulkanPixels);
+
+		double glSubmitMs = 0.0, vulkanSubmitMs = 0.0;
+		double glFps = runGl(programId, glSubmitMs);
+		double vulkanFps = vulkan.run(frames, vulkanSubmitMs);
+		std::cout << std::fixed << std::setprecision(3) << frames << " frames of two " << size.w << "x" << size.h << " eyes:" << std::endl;
+		std::cout << "  GL (" << glGetString(GL_RENDERER) << "): " << glSubmitMs << " ms CPU per frame, "
+			<< glFps << " frames/s, " << glGpuMs << " ms GPU per eye" << std::endl;
+		std::cout << "  Vulkan (" << vulkan.properties.deviceName << "): " << vulkanSubmitMs << " ms CPU per frame, "
+			<< vulkanFps << " frames/s" << std::endl;
+		std::cout << "  PSNR Vulkan vs GL: " << QualitySweep::psnr(vulkanPixels, glPixels) << " dB"
+			<< (vulkan.resources.samplers.empty() ? "" : " (textures read 0 in Vulkan)") << std::endl;
+		glDeleteProgram(programId);
+		return EXIT_SUCCESS;
+	}
+};
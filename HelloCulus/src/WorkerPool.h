@@ -0,0 +1,83 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Profiler.h"
+
+// Threads kept around for per-frame CPU work, so that no frame pays for creating them.
+// parallelFor() hands out indices one at a time (rows of tiles etc. differ a lot in cost), the calling thread helps.
+struct WorkerPool {
+	std::vector<std::thread> threads;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	std::function<void(int)> job;
+	std::atomic<int> next{ 0 };
+	int count = 0;
+	int busy = 0;
+	unsigned generation = 0;
+	bool quit = false;
+
+	// One thread per core besides the caller's by default
+	explicit WorkerPool(int threadCount = -1) {
+		if (threadCount < 0) { threadCount = std::max(1, (int)std::thread::hardware_concurrency() - 1); }
+		for (int i = 0; i < threadCount; i++) { threads.emplace_back([this] { work(); }); }
+	}
+
+	~WorkerPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			quit = true;
+		}
+		wake.notify_all();
+		for (std::thread& t : threads) { t.join(); }
+	}
+
+	int size() const { return (int)threads.size() + 1; }
+
+	// Calls fn(i) for i in [0, n) on all threads, returns when every call has returned.
+	void parallelFor(int n, const std::function<void(int)>& fn) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = fn;
+			count = n;
+			next = 0;
+			busy = (int)threads.size();
+			++generation;
+		}
+		wake.notify_all();
+		run();
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [this] { return busy == 0; });
+		job = nullptr;
+	}
+
+private:
+	void run() {
+		for (int i = next++; i < count; i = next++) { job(i); }
+	}
+
+	void work() {
+		profiler().nameThread("worker");
+		unsigned seen = 0;
+		for (;;) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [&] { return quit || generation != seen; });
+				if (quit) { return; }
+				seen = generation;
+			}
+			{
+				ProfileZone zone("worker job");
+				run();
+			}
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--busy == 0) { done.notify_one(); }
+		}
+	}
+};
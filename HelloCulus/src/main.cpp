@@ -1,4 +1,7 @@
+#include <chrono>
+#include <cmath>
 #include <fstream>
+#include <future>
 #include <iomanip>
 #include <iostream>
 #include <string>
@@ -7,13 +10,44 @@
 #include <glad/glad_wgl.h>
 #include <glad/glad.h>
 #include <GL/freeglut.h>
+// before Windows.h, which would pull in the old winsock.h
+#include <winsock2.h>
 #include <Windows.h>
 
 #include <OVR_CAPI.h>
 #include <OVR_CAPI_GL.h>
 #include <Extras/OVR_Math.h>
 
+#include "EyeCamera.h"
+#include "FrameRate.h"
+#include "FarField.h"
+#include "FrameCapture.h"
+#include "CostHeatmap.h"
+#include "Foveation.h"
+#include "FullscreenTriangle.h"
+#include "GlDebug.h"
+#include "GlState.h"
+#include "GpuTimer.h"
+#include "HiddenAreaMask.h"
+#include "InstanceBenchmark.h"
+#include "InstanceGrid.h"
+#include "Metrics.h"
+#include "NoiseBenchmark.h"
+#include "NoiseLibrary.h"
 #include "OculusBuffers.h"
+#include "Profiler.h"
+#include "QualitySweep.h"
+#include "RenderGraph.h"
+#include "ShaderSource.h"
+#include "SharedFrameExport.h"
+#include "SplitRenderer.h"
+#include "StartupTimer.h"
+#include "TemporalAccumulator.h"
+#include "TileCulling.h"
+#include "UsageMeter.h"
+#ifdef HELLOCULUS_VULKAN
+#include "VulkanBenchmark.h"
+#endif
 
 void printHmdInfo(const ovrHmdDesc& desc) {
 	std::cout << "Head Mounted Display Info" << std::endl;
@@ -43,10 +77,59 @@ void printPositionAndOrientation(ovrTrackingState ts, int timeStep) {
 int timeStep = 0;
 ovrSession session;
 OculusTextureBuffer* eyeRenderTexture[2] = { nullptr, nullptr };
+HiddenAreaMask* hiddenAreaMask[2] = { nullptr, nullptr };
+bool useHiddenAreaMask = true;
+FoveatedRenderer* foveation = nullptr;
+bool useFoveation = false;
+TemporalAccumulator* temporal = nullptr;
+bool useTemporal = true;
+bool shaderIsTemporal = false;
+SplitRenderer* split = nullptr;
+bool useSplit = true;
+RenderGraph* graph = nullptr;
+MonoFarField* farField = nullptr;
+bool useFarField = true;
+TileCuller* tileCuller = nullptr;
+InstanceGrid* instanceGrid = nullptr;
+NoiseLibrary* noise = nullptr;
+bool useTileCulling = true;
+CostHeatmap* costHeatmap = nullptr;
 long long frameIndex = 0;
+long long renderedFrames = 0; // frameIndex skips intervals at reduced frame rates
+long long eyeFrames[2] = { 0, 0 }; // frames rendered for each eye, they differ when alternating
+// Alternate-eye rendering: one eye per frame, the other one's previous image is submitted again with its old pose
+bool alternateEyes = false;
+bool eyeSubmitted[2] = { false, false };
+ovrPosef submittedPose[2];
+FrameRateControl frameRate;
+bool shaderWritesDepth = false;
+const float nearPlane = 0.2f;
+const float farPlane = 1000.0f;
 OVR::Sizei mirrorSize(600, 300);
 OculusMirrorBuffer* mirrorBuffer;
-GLuint prog, fragShaderId;
+double mirrorHz = 30.0;
+// Recording of the mirror texture, X starts and stops it
+FrameCapture* capture = nullptr;
+std::string capturePath = "HelloCulus.y4m";
+int captureCount = 0;
+// Z writes the CPU zones of this many last frames
+int traceFrames = 300;
+int traceCount = 0;
+// Mirror texture frames for other processes, with --export-frames
+SharedFrameExport* frameExport = nullptr;
+// Between the starts of consecutive displayed frames, to see what the mirror costs the headset loop
+std::chrono::steady_clock::time_point lastDisplay;
+double frameIntervalMs = 0.0;
+GpuTimer* eyesTimer;
+// CPU time issuing the eyes' GL calls, smoothed like the GPU time
+double eyesCpuMs = 0.0;
+// While the HMD isn't visible nothing is rendered, the session status is polled at a low rate instead
+bool hmdVisible = true;
+const unsigned int invisiblePollMs = 50;
+UsageMeter usage;
+// The shader's single program without and with RAY_DEPTH, prog is the one for the current frame rate
+GLuint programs[2], fragShaderIds[2];
+GLuint prog;
 std::string shader_filepath;
 float param1 = 0.1;
 const float PI = 3.141592653589793;
@@ -59,61 +142,208 @@ OVR::Vector3f originPos(-0.006, -0.798, -0.294);
 OVR::Matrix4f originRot = OVR::Matrix4f::RotationY(PI) * OVR::Matrix4f::Identity();
 int dir = 0;
 
-void loadShader() {
+// Served with --metrics-port for scraping without the console, updated on the render thread only
+MetricsRegistry metrics;
+MetricsServer* metricsServer = nullptr;
+MetricCounter& framesMetric = metrics.counter("helloculus_frames_total", "Frames submitted to the headset");
+MetricHistogram& frameIntervalMetric = metrics.histogram("helloculus_frame_interval_ms", "Time between the starts of displayed frames",
+	{ 5.0, 8.0, 11.2, 13.9, 16.7, 22.3, 33.4, 50.0, 100.0 });
+MetricHistogram& eyesCpuMetric = metrics.histogram("helloculus_eyes_cpu_ms", "CPU time issuing the GL calls of both eyes",
+	{ 0.25, 0.5, 1.0, 2.0, 4.0, 8.0, 16.0 });
+MetricHistogram& eyesGpuMetric = metrics.histogram("helloculus_eyes_gpu_ms", "GPU time rendering both eyes",
+	{ 2.0, 4.0, 6.0, 8.0, 9.5, 11.1, 14.0, 20.0, 33.3 });
+MetricGauge& divisorMetric = metrics.gauge("helloculus_frame_rate_divisor", "Display intervals each frame is shown for");
+MetricCounter& appDroppedMetric = metrics.counter("helloculus_app_dropped_frames_total", "Frames the app missed, from the runtime's performance stats");
+MetricCounter& compositorDroppedMetric = metrics.counter("helloculus_compositor_dropped_frames_total", "Frames the compositor missed");
+MetricGauge& stateChangesMetric = metrics.gauge("helloculus_gl_state_changes", "GL state changes of the last frame that reached the driver");
+MetricCounter& shaderLoadsMetric = metrics.counter("helloculus_shader_loads_total", "Shader builds, at startup, on reload and on frame rate changes");
+MetricCounter& shaderFailuresMetric = metrics.counter("helloculus_shader_load_failures_total", "Shader builds that failed to compile");
+MetricHistogram& shaderLoadMetric = metrics.histogram("helloculus_shader_load_ms", "Time to read, preprocess, compile and link a shader and its passes",
+	{ 10.0, 50.0, 100.0, 250.0, 500.0, 1000.0, 2500.0, 5000.0 });
+MetricGauge& costMapCallsMetric = metrics.gauge("helloculus_cost_map_calls_per_pixel", "Average map() calls per visible pixel while the cost heatmap is on");
+MetricGauge& costMapCallsP99Metric = metrics.gauge("helloculus_cost_map_calls_per_pixel_p99", "99th percentile of map() calls per visible pixel");
+MetricGauge& costMapCallsMaxMetric = metrics.gauge("helloculus_cost_map_calls_per_pixel_max", "Most map() calls of a pixel");
+MetricGauge& costIterationsMetric = metrics.gauge("helloculus_cost_loop_iterations_per_pixel", "Average shader loop iterations per visible pixel while the cost heatmap is on");
+MetricGauge& costIterationsP99Metric = metrics.gauge("helloculus_cost_loop_iterations_per_pixel_p99", "99th percentile of loop iterations per visible pixel");
+MetricGauge& costIterationsMaxMetric = metrics.gauge("helloculus_cost_loop_iterations_per_pixel_max", "Most loop iterations of a pixel");
+MetricCounter& mirrorPresentsMetric = metrics.counter("helloculus_mirror_presents_total", "Mirror window updates");
+MetricHistogram& mirrorMetric = metrics.histogram("helloculus_mirror_ms", "CPU time of a mirror blit and swap",
+	{ 0.1, 0.25, 0.5, 1.0, 2.0, 4.0, 8.0, 16.0 });
+
+void selectProgram();
+
+// Returns false when the shader didn't compile, the previous program stays.
+bool buildShader() {
 	// (2160, 1200), (1344, 1600)
 	const static char* shader_simple_flat = \
+		"#version 410\n"
 		"uniform float time = 0.0f;"
-		"varying vec4 v;"
+		"out vec4 fragColor;"
 		"void main() {"
 		"    vec2 v = gl_FragCoord.xy / vec2(1344, 1600);"
 		"    v = mod(vec2(v.x + time, v.y), 1.0);"
-		"    gl_FragColor = vec4(floor(v.x * 10) / 10, floor(v.y * 10) / 10, 0.0, 1.0);"
+		"    fragColor = vec4(floor(v.x * 10) / 10, floor(v.y * 10) / 10, 0.0, 1.0);"
 		"}";
 
-	const char* shader_code;
-	if (shader_filepath.empty()) {
-		glShaderSource(fragShaderId, 1, &shader_simple_flat, 0);
-	}
-	else {
+	std::string code = shader_simple_flat;
+	std::string depthCode; // with RAY_DEPTH, only for shaders that write depth
+	if (!shader_filepath.empty()) {
 		std::cout << "Loading shader file... " << shader_filepath << std::endl;
-		std::ifstream input_file(shader_filepath);
-		if (!input_file.is_open()) { std::cerr << "Could not open file: " << shader_filepath << std::endl; exit(EXIT_FAILURE); }
-		std::string shader_string = std::string((std::istreambuf_iterator<char>(input_file)), std::istreambuf_iterator<char>());
-		const char* code = shader_string.c_str();
-		glShaderSource(fragShaderId, 1, &code, 0);
-	}
-
-	glCompileShader(fragShaderId);
-	GLint is_compiled = 0;
-	glGetShaderiv(fragShaderId, GL_COMPILE_STATUS, &is_compiled);
-	GLint logLength = 0;
-	glGetShaderiv(fragShaderId, GL_INFO_LOG_LENGTH, &logLength);
-	// Can compile and have warnings, or can fail and have errors etc.
-	if (logLength > 0) {
-		std::vector<GLchar> infoLog(logLength);
-		glGetShaderInfoLog(fragShaderId, logLength, NULL, &infoLog[0]);
-		std::cout << "Log: " << std::string(infoLog.begin(), infoLog.end()) << std::endl;
-	}
-	if (is_compiled == GL_FALSE) {
-		std::cout << "Shader compilation failed." << is_compiled << std::endl;
-		return;
-	}
-	glAttachShader(prog, fragShaderId);
-	glLinkProgram(prog);
-	glUseProgram(prog);
+		ShaderSource source;
+		if (!source.load(shader_filepath)) { exit(EXIT_FAILURE); }
+		ShaderDefines defines;
+		// real depth for positional reprojection, only worth its per-frame depth clears when frames get reprojected
+		shaderWritesDepth = source.body.find("writeRayDepth(") != std::string::npos;
+		// scenes of many primitive instances are built on the CPU, every program of the shader traverses the grid
+		if (instanceGrid && instanceGrid->load(source)) { defines.push_back({ "INSTANCE_GRID", "1" }); }
+		// Frame rate switches must not rebuild anything. The passes always get RAY_DEPTH when the shader writes depth,
+		// at full rate drawScene masks depth writes. The single program is built in both variants (selectProgram()).
+		ShaderDefines passDefines = defines;
+		if (shaderWritesDepth) { passDefines.push_back({ "RAY_DEPTH", "1" }); }
+		// multi-pass shaders replace the single program
+		if (graph) { graph->load(source, passDefines); }
+		if (farField) { farField->load(source, passDefines); }
+		if (tileCuller) { tileCuller->load(source); }
+		// split passes always run all samples, temporal accumulation takes precedence when both are declared
+		if (split) { split->load(source, passDefines); }
+		const ShaderDirective* temporalDirective = source.findDirective("temporal");
+		shaderIsTemporal = temporalDirective != nullptr;
+		// the heatmap shows the single program, with all of its samples
+		const bool cost = costHeatmap && costHeatmap->active();
+		if (cost) { defines.push_back({ "COST_HEATMAP", "1" }); }
+		else if (shaderIsTemporal) {
+			defines.push_back({ "TEMPORAL", "1" });
+			int phases = 0;
+			if (temporal && temporalDirective->number(0, phases)) { temporal->phases = std::max(1, phases); }
+		}
+		code = source.build(defines);
+		if (shaderWritesDepth) {
+			defines.push_back({ "RAY_DEPTH", "1" });
+			depthCode = source.build(defines);
+		}
+		if (foveation) { foveation->configure(FoveationConfig::fromShader(source, foveation->config)); }
+		if (temporal) { temporal->reset(); }
+	}
+
+	// already built while the session was created at startup, or the reload changed nothing the program sees
+	static std::string linkedCode[2];
+	const std::string* variants[2] = { &code, &depthCode };
+	for (int v = 0; v < 2; v++) {
+		if (variants[v]->empty() || *variants[v] == linkedCode[v]) { continue; }
+		ProfileZone zone("compile and link");
+		if (!compileShader(fragShaderIds[v], *variants[v])) { return false; }
+		glLinkProgram(programs[v]);
+		GLint isLinked = 0;
+		glGetProgramiv(programs[v], GL_LINK_STATUS, &isLinked);
+		if (isLinked == GL_FALSE) { std::cout << "Shader link failed." << std::endl; return false; }
+		linkedCode[v] = *variants[v];
+	}
+	selectProgram();
+	return true;
+}
+
+// The single program variant for the frame rate, with RAY_DEPTH only when frames get reprojected
+void selectProgram() {
+	prog = programs[shaderWritesDepth && frameRate.divisor > 1 ? 1 : 0];
+	glState().useProgram(prog);
+}
+
+void loadShader() {
+	ProfileZone zone("loadShader");
+	// the counts belong to the program that's replaced
+	if (costHeatmap && (costHeatmap->pixels > 0 || costHeatmap->pending > 0)) { costHeatmap->report(shader_filepath); }
+	auto begin = std::chrono::steady_clock::now();
+	bool built = buildShader();
+	shaderLoadMetric.observe(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count());
+	shaderLoadsMetric.add();
+	if (!built) { shaderFailuresMetric.add(); }
+}
+
+// Raymarches the bound render target with the given program. rayRight and rayUp span the whole eye, the per-pixel
+// ray basis is derived from the target's size so that an eye can be rendered at any resolution.
+// writeDepth keeps the depth written by shaders built with RAY_DEPTH.
+void drawScene(GLuint program, OVR::Sizei size, const OVR::Vector3f& rayRight, const OVR::Vector3f& rayUp, bool writeDepth = false) {
+	ProfileZone zone("drawScene");
+	OVR::Vector3f rayDx = rayRight / (float)size.w;
+	OVR::Vector3f rayDy = rayUp / (float)size.h;
+	glProgramUniform2f(program, glGetUniformLocation(program, "resolution"), (float)size.w, (float)size.h);
+	glProgramUniform3f(program, glGetUniformLocation(program, "rayDx"), rayDx.x, rayDx.y, rayDx.z);
+	glProgramUniform3f(program, glGetUniformLocation(program, "rayDy"), rayDy.x, rayDy.y, rayDy.z);
+
+	// Fragments under primed depth (hidden area, other foveation rings) fail the early depth test, before the shader runs.
+	// The triangle is at the near plane, so ray depth (declared depth_greater) can't turn a failed test into a pass.
+	glProgramUniform2f(program, glGetUniformLocation(program, "depthPlanes"), nearPlane, farPlane);
+	glState().enable(GL_DEPTH_TEST);
+	glState().depthFunc(GL_LESS);
+	glState().depthMask(writeDepth ? GL_TRUE : GL_FALSE);
+	fullscreen().draw(program, -1.0f);
+	glState().depthMask(GL_TRUE);
+	glState().disable(GL_DEPTH_TEST);
+}
+
+void glutIdle();
+void glutPollSession(int);
+
+void pauseRendering() {
+	if (!hmdVisible) { return; }
+	hmdVisible = false;
+	std::cout << std::endl;
+	usage.print("Rendered", *eyesTimer);
+	std::cout << "HMD not visible, pausing (polling every " << invisiblePollMs << " ms)" << std::endl;
+	usage.reset(*eyesTimer);
+	glutIdleFunc(nullptr);
+	glutTimerFunc(invisiblePollMs, glutPollSession, 0);
+}
+
+void resumeRendering() {
+	hmdVisible = true;
+	usage.print("Paused", *eyesTimer);
+	usage.reset(*eyesTimer);
+	glutIdleFunc(glutIdle);
+	// the pause isn't a frame interval
+	lastDisplay = std::chrono::steady_clock::now();
+	glutPostRedisplay();
+}
+
+// Low rate check of the session while paused, glutMainLoop sleeps in between.
+void glutPollSession(int) {
+	ovrSessionStatus sessionStatus;
+	ovr_GetSessionStatus(session, &sessionStatus);
+	if (sessionStatus.ShouldQuit) { glutLeaveMainLoop(); return; }
+	if (sessionStatus.IsVisible) { resumeRendering(); return; }
+	glutTimerFunc(invisiblePollMs, glutPollSession, 0);
 }
 
 void glutDisplay(void) {
+	profiler().frame();
+	ProfileZone frameZone("frame");
 	ovrSessionStatus sessionStatus;
 	ovrResult result;
-	ovr_GetSessionStatus(session, &sessionStatus);
+	{
+		ProfileZone zone("ovr_GetSessionStatus");
+		ovr_GetSessionStatus(session, &sessionStatus);
+	}
+	if (sessionStatus.ShouldQuit) { glutLeaveMainLoop(); return; }
+	// Nothing to render, and no reason to query poses or blit the mirror either
+	if (!sessionStatus.IsVisible) { pauseRendering(); return; }
+	auto displayBegin = std::chrono::steady_clock::now();
+	double intervalMs = std::chrono::duration<double, std::milli>(displayBegin - lastDisplay).count();
+	if (timeStep > 0) {
+		frameIntervalMs = frameIntervalMs == 0.0 ? intervalMs : frameIntervalMs * 0.95 + intervalMs * 0.05;
+		frameIntervalMetric.observe(intervalMs);
+	}
+	lastDisplay = displayBegin;
 
 	// Call ovr_GetRenderDesc each frame to get the ovrEyeRenderDesc, as the returned values (e.g. HmdToEyePose) may change at runtime.
 	ovrEyeRenderDesc eyeRenderDesc[2];
 	ovrPosef hmdToEyeViewPose[2];
-	ovrHmdDesc hmdDesc2 = ovr_GetHmdDesc(session);
-	eyeRenderDesc[0] = ovr_GetRenderDesc(session, ovrEye_Left, hmdDesc2.DefaultEyeFov[0]);
-	eyeRenderDesc[1] = ovr_GetRenderDesc(session, ovrEye_Right, hmdDesc2.DefaultEyeFov[1]);
+	ovrHmdDesc hmdDesc2;
+	{
+		ProfileZone zone("ovr_GetRenderDesc");
+		hmdDesc2 = ovr_GetHmdDesc(session);
+		eyeRenderDesc[0] = ovr_GetRenderDesc(session, ovrEye_Left, hmdDesc2.DefaultEyeFov[0]);
+		eyeRenderDesc[1] = ovr_GetRenderDesc(session, ovrEye_Right, hmdDesc2.DefaultEyeFov[1]);
+	}
 	hmdToEyeViewPose[0] = eyeRenderDesc[0].HmdToEyePose;
 	hmdToEyeViewPose[1] = eyeRenderDesc[1].HmdToEyePose;
 
@@ -121,97 +351,281 @@ void glutDisplay(void) {
 	ovrPosef EyeRenderPose[2];
 	ovrPosef HmdToEyePose[2] = { eyeRenderDesc[0].HmdToEyePose,
 								 eyeRenderDesc[1].HmdToEyePose };
-	double sensorSampleTime;    // sensorSampleTime is fed into the layer later
-	ovr_GetEyePoses(session, frameIndex, ovrTrue, HmdToEyePose, EyeRenderPose, &sensorSampleTime);
+	// Predicted for the middle of the display intervals this frame will be shown for (one at full rate)
+	double sensorSampleTime = ovr_GetTimeInSeconds();    // sensorSampleTime is fed into the layer later
+	ovrTrackingState hmdState;
+	{
+		ProfileZone zone("eye poses");
+		hmdState = ovr_GetTrackingState(session, frameRate.predictedDisplayTime(session, frameIndex), ovrTrue);
+		ovr_CalcEyePoses(hmdState.HeadPose.ThePose, HmdToEyePose, EyeRenderPose);
+	}
 
 	ovrTrackerDesc trackerDesc = ovr_GetTrackerDesc(session, 0);
 
 	ovrTimewarpProjectionDesc posTimewarpProjectionDesc = {};
 
-	if (sessionStatus.ShouldQuit) glutLeaveMainLoop();
 	if (sessionStatus.ShouldRecenter) ovr_RecenterTrackingOrigin(session);
-	if (sessionStatus.IsVisible) {
-		// Get next available index of the texture swap chain
-		int currentIndex = 0;
+	// Get next available index of the texture swap chain
+	int currentIndex = 0;
+	{
+		ProfileZone zone("ovr_WaitToBeginFrame");
 		result = ovr_WaitToBeginFrame(session, frameIndex);
+	}
 
-		// Render Scene to Eye Buffers
+	// Render Scene to Eye Buffers
+	{
+		ProfileZone zone("ovr_BeginFrame");
 		result = ovr_BeginFrame(session, frameIndex);
-		for (int eye = 0; eye < 2; eye++) {
+	}
+	// the runtime and freeglut bind things of their own between frames
+	glState().invalidate();
+	eyesTimer->begin();
+	costHeatmap->beginFrame();
+	const bool costFrame = costHeatmap->active();
+	auto eyesBegin = std::chrono::steady_clock::now();
+	// Uniforms every program gets for the camera it renders from
+	auto setCameraUniforms = [&](GLuint program, const EyeCamera& camera, const OVR::Matrix4f& view, const OVR::Matrix4f& proj, int eye) {
+		GLint uTime = glGetUniformLocation(program, "time");
+		glProgramUniform1f(program, uTime, sensorSampleTime);
+		GLint uEyePos = glGetUniformLocation(program, "ro");
+		glProgramUniform3f(program, uEyePos, camera.position.x, camera.position.y, camera.position.z);
+		GLint uView = glGetUniformLocation(program, "view");
+		glProgramUniformMatrix4fv(program, uView, 1, GL_FALSE, &(view.M[0][0]));
+		GLint uProj = glGetUniformLocation(program, "proj");
+		glProgramUniformMatrix4fv(program, uProj, 1, GL_FALSE, &(proj.M[0][0]));
+		glProgramUniform1f(program, glGetUniformLocation(program, "frustFovH"), trackerDesc.FrustumHFovInRadians);
+		glProgramUniform1f(program, glGetUniformLocation(program, "frustFovV"), trackerDesc.FrustumVFovInRadians);
+		glProgramUniform1i(program, glGetUniformLocation(program, "eyeNo"), eye);
+		glProgramUniform1f(program, glGetUniformLocation(program, "param1"), param1);
+		OVR::Vector3f rayCorner = camera.rayCorner();
+		glProgramUniform3f(program, glGetUniformLocation(program, "rayCorner"), rayCorner.x, rayCorner.y, rayCorner.z);
+		glProgramUniform3f(program, glGetUniformLocation(program, "eyeForward"), camera.forward.x, camera.forward.y, camera.forward.z);
+		if (instanceGrid->active()) { instanceGrid->setUniforms(program); }
+		noise->setUniforms(program);
+	};
+	if (instanceGrid->active()) { instanceGrid->bind(); }
+
+	// Distant content is marched once for both eyes, from between them. Only for the plain single program path, it
+	// takes precedence over the split pipeline when a shader declares both.
+	const bool farFieldFrame = !costFrame && useFarField && farField->active() && !graph->active()
+		&& !(useTemporal && shaderIsTemporal);
+	if (farFieldFrame) {
+		ProfileZone zone("far field");
+		OVR::Vector3f center = originPos + (OVR::Vector3f(EyeRenderPose[0].Position) + OVR::Vector3f(EyeRenderPose[1].Position)) * 0.5f;
+		OVR::Matrix4f rot = originRot * OVR::Matrix4f(hmdState.HeadPose.ThePose.Orientation);
+		EyeCamera camera = farField->centerCamera(center, rot);
+		OVR::Matrix4f view = OVR::Matrix4f::LookAtRH(camera.position, camera.position + camera.forward, camera.up);
+		OVR::Matrix4f proj = ovrMatrix4f_Projection(camera.fov, nearPlane, farPlane, ovrProjection_None);
+		farField->render(camera,
+			[&](GLuint program) { setCameraUniforms(program, camera, view, proj, 0); },
+			[&](GLuint program, OVR::Sizei size) { drawScene(program, size, camera.rayRight(), camera.rayUp()); });
+	}
+	const GLuint sceneProg = farFieldFrame ? farField->nearProg : prog;
+
+	for (int eye = 0; eye < 2; eye++) {
+		// Skipped eye: its swap chains aren't committed, so the compositor reprojects the last image from submittedPose
+		if (alternateEyes && eyeSubmitted[eye] && eyeSubmitted[1 - eye] && eye != renderedFrames % 2) { continue; }
+		GlDebugGroup eyeGroup(eye == 0 ? "left eye" : "right eye");
+		ProfileZone eyeZone(eye == 0 ? "left eye" : "right eye");
+
+		// Get view and projection matrices for the Rift camera
+		OVR::Vector3f pos = originPos + EyeRenderPose[eye].Position; // originRot.Transform(EyeRenderPose[eye].Position); // can scale Position to make camera move faster in VR world
+		OVR::Matrix4f rot = originRot * OVR::Matrix4f(EyeRenderPose[eye].Orientation);
+
+		finalUp = rot.Transform(OVR::Vector3f(0, 1, 0));
+		finalForward = rot.Transform(OVR::Vector3f(0, 0, -1));
+		finalSide = rot.Transform(OVR::Vector3f(1, 0, 0));
+		OVR::Matrix4f view = OVR::Matrix4f::LookAtRH(pos, pos + finalForward, finalUp);
+		OVR::Matrix4f proj = ovrMatrix4f_Projection(hmdDesc2.DefaultEyeFov[eye], nearPlane, farPlane, ovrProjection_None);
+		OVR::Matrix4f combined = proj * view;
+
+		// Ray through window pixel (x, y) is rayCorner + x * rayDx + y * rayDy. Computed once per eye from the
+		// asymmetric FOV instead of rebuilding the camera basis for every pixel in the shader.
+		EyeCamera camera = { pos, finalSide, finalUp, finalForward, hmdDesc2.DefaultEyeFov[eye] };
+		OVR::Vector3f rayRight = camera.rayRight();
+		OVR::Vector3f rayUp = camera.rayUp();
+
+		posTimewarpProjectionDesc = ovrTimewarpProjectionDesc_FromProjection(proj, ovrProjection_None);
+
+		OVR::Vector3f v1(-1.5, -1.5, -1.0);
+		OVR::Vector3f v2(1.5, 1.0, -1.0);
+		OVR::Vector3f v3(1.0, 1.5, -1.0);
+		v1 = combined.Transform(v1);
+		v2 = combined.Transform(v2);
+		v3 = combined.Transform(v3);
+
+		// Empty space in front of each tile is proven on the CPU while the GPU still works on the previous eye
+		const bool cullEye = useTileCulling && tileCuller->active();
+		if (cullEye) {
+			ProfileZone zone("tile culling");
+			tileCuller->cull(eye, camera, (float)sensorSampleTime);
+		}
+
+		const bool graphEye = !costFrame && graph->active();
+		const bool temporalEye = !costFrame && !graphEye && useTemporal && shaderIsTemporal;
+		const bool splitEye = !costFrame && !graphEye && !temporalEye && !farFieldFrame && useSplit && split->active();
+		auto setUniforms = [&](GLuint program) {
+			setCameraUniforms(program, camera, view, proj, eye);
+			glProgramUniform1i(program, glGetUniformLocation(program, "temporalFrame"), (int)(eyeFrames[eye] % 1000000));
+			glProgramUniform1i(program, glGetUniformLocation(program, "temporalPhases"), temporalEye ? temporal->phases : 1);
+			tileCuller->setUniforms(program, eye, cullEye);
+			if (costFrame) { costHeatmap->setUniforms(program); }
+		};
+		{
+			ProfileZone zone("setUniforms");
+			setUniforms(prog);
+		}
+
+		// Only what lands in the eye buffer keeps its ray depth, offscreen targets keep their primed depth
+		const bool rayDepth = shaderWritesDepth && frameRate.divisor > 1;
+		auto drawEye = [&](OVR::Sizei size) { drawScene(sceneProg, size, rayRight, rayUp); };
+		auto drawPass = [&](GLuint program, OVR::Sizei size) { drawScene(program, size, rayRight, rayUp); };
+		auto drawPassToEye = [&](GLuint program, OVR::Sizei size) { drawScene(program, size, rayRight, rayUp, rayDepth); };
+		bool foveatedEye = false;
+		if (graphEye) {
+			// Passes declared by the shader, the last one shades the eye buffer
+			graph->renderOffscreen(eye, setUniforms, drawPass);
+			eyeRenderTexture[eye]->SetAndClearRenderSurface();
+			if (useHiddenAreaMask) { hiddenAreaMask[eye]->primeDepth(); }
+			graph->renderOutput(eye, setUniforms, drawPassToEye);
+		}
+		else if (temporalEye) {
+			// Partial samples into an offscreen target, then blended with the reprojected history into the eye buffer
+			temporal->renderCurrent(eye, useHiddenAreaMask ? hiddenAreaMask[eye] : nullptr, drawEye);
+			eyeRenderTexture[eye]->SetAndClearRenderSurface();
+			temporal->resolve(eye, camera, eyeRenderTexture[eye]->fboId);
+		}
+		else if (splitEye) {
+			// Primary hit at full resolution, expensive terms at reduced resolution, then upsampled while shading
+			split->renderOffscreen(eye, useHiddenAreaMask ? hiddenAreaMask[eye] : nullptr, setUniforms, drawPass);
 			eyeRenderTexture[eye]->SetAndClearRenderSurface();
+			if (useHiddenAreaMask) { hiddenAreaMask[eye]->primeDepth(); }
+			split->renderComposite(eye, setUniforms, drawPassToEye);
+		}
+		else {
+			foveatedEye = useFoveation;
+			if (farFieldFrame) {
+				// near field only, up to the stereo distance
+				setUniforms(sceneProg);
+				farField->bindNear();
+			}
+			if (useFoveation) {
+				foveation->renderPeriphery(eye, useHiddenAreaMask ? hiddenAreaMask[eye] : nullptr, drawEye);
+			}
 
-			// Get view and projection matrices for the Rift camera
-			OVR::Vector3f pos = originPos + EyeRenderPose[eye].Position; // originRot.Transform(EyeRenderPose[eye].Position); // can scale Position to make camera move faster in VR world
-			OVR::Matrix4f rot = originRot * OVR::Matrix4f(EyeRenderPose[eye].Orientation);
-
-			finalUp = rot.Transform(OVR::Vector3f(0, 1, 0));
-			finalForward = rot.Transform(OVR::Vector3f(0, 0, -1));
-			finalSide = rot.Transform(OVR::Vector3f(1, 0, 0));
-			OVR::Matrix4f view = OVR::Matrix4f::LookAtRH(pos, pos + finalForward, finalUp);
-			OVR::Matrix4f proj = ovrMatrix4f_Projection(hmdDesc2.DefaultEyeFov[eye], 0.2f, 1000.0f, ovrProjection_None);
-			OVR::Matrix4f combined = proj * view;
-
-			posTimewarpProjectionDesc = ovrTimewarpProjectionDesc_FromProjection(proj, ovrProjection_None);
-
-			OVR::Vector3f v1(-1.5, -1.5, -1.0);
-			OVR::Vector3f v2(1.5, 1.0, -1.0);
-			OVR::Vector3f v3(1.0, 1.5, -1.0);
-			v1 = combined.Transform(v1);
-			v2 = combined.Transform(v2);
-			v3 = combined.Transform(v3);
-
-			GLint uTime = glGetUniformLocation(prog, "time");
-			glProgramUniform1f(prog, uTime, sensorSampleTime);
-			GLint uEyePos = glGetUniformLocation(prog, "ro");
-			glProgramUniform3f(prog, uEyePos, pos.x, pos.y, pos.z);
-			GLint uView = glGetUniformLocation(prog, "view");
-			glProgramUniformMatrix4fv(prog, uView, 1, GL_FALSE, &(view.M[0][0]));
-			GLint uProj = glGetUniformLocation(prog, "proj");
-			glProgramUniformMatrix4fv(prog, uProj, 1, GL_FALSE, &(proj.M[0][0]));
-			glProgramUniform1f(prog, glGetUniformLocation(prog, "frustFovH"), trackerDesc.FrustumHFovInRadians);
-			glProgramUniform1f(prog, glGetUniformLocation(prog, "frustFovV"), trackerDesc.FrustumVFovInRadians);
-			glProgramUniform1i(prog, glGetUniformLocation(prog, "eyeNo"), eye);
-			glProgramUniform1f(prog, glGetUniformLocation(prog, "param1"), param1);
-
-			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-			glBegin(GL_QUADS);
-			glVertex3f(-1, -1, 0);
-			glVertex3f(1, -1, 0);
-			glVertex3f(1, 1, 0);
-			glVertex3f(-1, 1, 0);
-			glEnd();
-
-
-			eyeRenderTexture[eye]->UnsetRenderSurface();
-			eyeRenderTexture[eye]->Commit();
+			eyeRenderTexture[eye]->SetAndClearRenderSurface();
+			if (useHiddenAreaMask) { hiddenAreaMask[eye]->primeDepth(); }
+			if (useFoveation) { foveation->primeCenter(eye); }
+			drawScene(sceneProg, eyeRenderTexture[eye]->GetSize(), rayRight, rayUp, rayDepth);
+			if (useFoveation) { foveation->composite(eye); }
 		}
 
-		ovrLayerEyeFovDepth ld = {};
-		ld.Header.Type = ovrLayerType_EyeFovDepth;
-		ld.Header.Flags = ovrLayerFlag_TextureOriginAtBottomLeft;
-		ld.ProjectionDesc = posTimewarpProjectionDesc;
-		ld.SensorSampleTime = sensorSampleTime;
-		for (int eye = 0; eye < 2; ++eye)
+		// The depth swap chain goes to the compositor, which would reproject primed pixels as if they were at the near
+		// plane. They get far depth like the rest without ray depth, the eye buffer's depth is cleared and primed every frame.
+		if (useHiddenAreaMask && !temporalEye) { hiddenAreaMask[eye]->primeDepth(1.0f); }
+		if (foveatedEye) { foveation->farPeriphery(eye); }
+		eyeRenderTexture[eye]->UnsetRenderSurface();
 		{
-			ld.ColorTexture[eye] = eyeRenderTexture[eye]->ColorTextureChain;
-			ld.DepthTexture[eye] = eyeRenderTexture[eye]->DepthTextureChain;
-			ld.Viewport[eye] = OVR::Recti(eyeRenderTexture[eye]->GetSize());
-			ld.Fov[eye] = hmdDesc2.DefaultEyeFov[eye];
-			ld.RenderPose[eye] = EyeRenderPose[eye];
+			ProfileZone zone("ovr_CommitTextureSwapChain");
+			eyeRenderTexture[eye]->Commit();
 		}
-		// Submit frame with one layer we have.
-		ovrLayerHeader* layers = &ld.Header;
-		unsigned int layerCount = 1;
+		submittedPose[eye] = EyeRenderPose[eye];
+		eyeSubmitted[eye] = true;
+		eyeFrames[eye]++;
+	}
+	costHeatmap->endFrame();
+	if (costFrame) {
+		costHeatmap->update();
+		costMapCallsMetric.set(costHeatmap->shown[0].average);
+		costMapCallsP99Metric.set(costHeatmap->shown[0].p99);
+		costMapCallsMaxMetric.set(costHeatmap->shown[0].max);
+		costIterationsMetric.set(costHeatmap->shown[1].average);
+		costIterationsP99Metric.set(costHeatmap->shown[1].p99);
+		costIterationsMaxMetric.set(costHeatmap->shown[1].max);
+	}
+	const long long gpuCollected = eyesTimer->collected;
+	{
+		ProfileZone zone("GPU timer");
+		eyesTimer->end();
+	}
+	if (eyesTimer->collected != gpuCollected) { eyesGpuMetric.observe(eyesTimer->lastMs); }
+	double eyesMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - eyesBegin).count();
+	eyesCpuMs = eyesCpuMs == 0.0 ? eyesMs : eyesCpuMs * 0.95 + eyesMs * 0.05;
+	eyesCpuMetric.observe(eyesMs);
+	stateChangesMetric.set(glState().changes);
+	glState().endFrame();
+	tileCuller->endFrame();
+
+	ovrLayerEyeFovDepth ld = {};
+	ld.Header.Type = ovrLayerType_EyeFovDepth;
+	ld.Header.Flags = ovrLayerFlag_TextureOriginAtBottomLeft;
+	ld.ProjectionDesc = posTimewarpProjectionDesc;
+	ld.SensorSampleTime = sensorSampleTime;
+	for (int eye = 0; eye < 2; ++eye)
+	{
+		ld.ColorTexture[eye] = eyeRenderTexture[eye]->ColorTextureChain;
+		ld.DepthTexture[eye] = eyeRenderTexture[eye]->DepthTextureChain;
+		ld.Viewport[eye] = OVR::Recti(eyeRenderTexture[eye]->GetSize());
+		ld.Fov[eye] = hmdDesc2.DefaultEyeFov[eye];
+		ld.RenderPose[eye] = submittedPose[eye];
+	}
+	// Submit frame with one layer we have.
+	ovrLayerHeader* layers = &ld.Header;
+	unsigned int layerCount = 1;
+	{
+		ProfileZone zone("ovr_EndFrame");
 		result = ovr_EndFrame(session, frameIndex, nullptr, &layers, layerCount);
+	}
+	{
+		ProfileZone zone("readbacks");
+		capture->capture(mirrorBuffer->fboId);
+		frameExport->publish(mirrorBuffer->fboId);
+	}
 
-		++frameIndex;
+	// the compositor keeps reprojecting this frame for the skipped intervals
+	frameIndex += frameRate.divisor;
+	++renderedFrames;
+	framesMetric.add();
+	divisorMetric.set(frameRate.divisor);
+	if (metricsServer) {
+		ProfileZone zone("ovr_GetPerfStats");
+		ovrPerfStats perfStats;
+		if (OVR_SUCCESS(ovr_GetPerfStats(session, &perfStats)) && perfStats.FrameStatsCount > 0) {
+			appDroppedMetric.set(perfStats.FrameStats[0].AppDroppedFrameCount);
+			compositorDroppedMetric.set(perfStats.FrameStats[0].CompositorDroppedFrameCount);
+		}
 	}
+	usage.addFrame();
+	if (frameRate.update(eyesTimer->smoothedMs)) { selectProgram(); }
 
-	ovrTrackingState ts = ovr_GetTrackingState(session, ovr_GetTimeInSeconds(), ovrTrue);
-	printPositionAndOrientation(ts, timeStep);
+	{
+		ProfileZone zone("status line");
+		ovrTrackingState ts = ovr_GetTrackingState(session, ovr_GetTimeInSeconds(), ovrTrue);
+		printPositionAndOrientation(ts, timeStep);
+		std::cout << " eyes GPU: " << std::noshowpos << std::setprecision(2) << eyesTimer->smoothedMs << " ms"
+			<< " CPU: " << eyesCpuMs << " ms" << " rate: 1/" << frameRate.divisor;
+		if (useTileCulling && tileCuller->active()) { std::cout << " cull CPU: " << tileCuller->smoothedMs << " ms"; }
+		if (costHeatmap->active()) {
+			const CostStats& cost = costHeatmap->shown[costHeatmap->view == CostView::Iterations ? 1 : 0];
+			std::cout << " " << costHeatmap->name() << ": " << std::setprecision(1) << cost.average << " p99 " << cost.p99 << " max " << cost.max;
+		}
+		std::cout << " state changes: " << std::setprecision(0) << glState().smoothedChanges
+			<< " (" << glState().smoothedRedundant << " filtered)";
+		std::cout << " frame: " << std::setprecision(2) << frameIntervalMs << " ms mirror: " << mirrorBuffer->smoothedMs << " ms";
+		if (frameExport->active()) { std::cout << " exported: " << frameExport->published << " frames, " << frameExport->readback.dropped << " dropped"; }
+		if (capture->recording) {
+			std::cout << " capture: " << capture->captured() << " frames, " << capture->dropped() << " dropped";
+		}
+		std::cout << std::flush;
+	}
+	glDebugLog().flush();
 	timeStep++;
 
-	mirrorBuffer->render();
+	ProfileZone mirrorZone("mirror");
+	if (mirrorBuffer->render()) {
+		mirrorPresentsMetric.add();
+		mirrorMetric.observe(mirrorBuffer->lastMs);
+	}
 }
 
 void glutIdle() {
@@ -226,6 +640,80 @@ void glutKeyboard(unsigned char key, int x, int y) {
 	if (key == 'g') {
 		loadShader();
 	}
+	if (key == 'h') {
+		useHiddenAreaMask = !useHiddenAreaMask;
+		foveation->invalidate();
+		temporal->invalidate();
+		split->invalidate();
+		std::cout << "hidden area mask: " << (useHiddenAreaMask ? "on" : "off") << std::endl;
+	}
+	if (key == 'f') {
+		useFoveation = !useFoveation;
+		std::cout << "foveated rendering: " << (useFoveation ? "on" : "off") << std::endl;
+	}
+	if (key == 't') {
+		useTemporal = !useTemporal;
+		temporal->reset();
+		std::cout << "temporal accumulation: " << (useTemporal ? "on" : "off") << (shaderIsTemporal ? "" : " (shader has no // @temporal)") << std::endl;
+	}
+	if (key == 'u') {
+		useSplit = !useSplit;
+		std::cout << "split effect pipeline: " << (useSplit ? "on" : "off") << (split->active() ? "" : " (shader has no // @split)") << std::endl;
+	}
+	if (key == 'r') {
+		frameRate.cycleMode();
+		std::cout << "frame rate mode: " << frameRate.name() << std::endl;
+	}
+	if (key == 'l') {
+		alternateEyes = !alternateEyes;
+		std::cout << "alternate-eye rendering: " << (alternateEyes ? "on" : "off") << std::endl;
+	}
+	if (key == 'm') {
+		useFarField = !useFarField;
+		std::cout << "mono far field: " << (useFarField ? "on" : "off") << (farField->active() ? "" : " (shader has no // @farfield)") << std::endl;
+	}
+	if (key == 'c') {
+		useTileCulling = !useTileCulling;
+		std::cout << "tile culling: " << (useTileCulling ? "on" : "off") << (tileCuller->active() ? "" : " (shader has no // @cull)") << std::endl;
+	}
+	if (key == 'o') {
+		mirrorBuffer->cycleMode();
+		std::cout << "mirror: " << mirrorBuffer->name();
+		if (mirrorBuffer->mode == MirrorMode::Limited) { std::cout << " (" << mirrorBuffer->rateHz << " Hz)"; }
+		if (mirrorBuffer->mode == MirrorMode::OnDemand) { std::cout << " (P presents a frame)"; }
+		std::cout << std::endl;
+	}
+	if (key == 'p') {
+		mirrorBuffer->request();
+	}
+	if (key == 'x') {
+		if (capture->recording) { capture->stop(); }
+		else {
+			// later recordings of the run get numbered instead of overwriting the first
+			std::string path = capturePath;
+			if (++captureCount > 1) {
+				size_t dot = path.find_last_of('.');
+				path.insert(dot == std::string::npos ? path.size() : dot, "-" + std::to_string(captureCount));
+			}
+			capture->start(path, (int)std::lround(frameRate.refreshRate / frameRate.divisor));
+		}
+	}
+	if (key == 'z') {
+		std::string path = "HelloCulus-trace.json";
+		if (++traceCount > 1) { path.insert(path.find_last_of('.'), "-" + std::to_string(traceCount)); }
+		profiler().dump(path, traceFrames);
+	}
+	if (key == 'i') {
+		const bool wasActive = costHeatmap->active();
+		costHeatmap->cycleView();
+		std::cout << "cost heatmap: " << costHeatmap->name() << std::endl;
+		// built with or without the counters
+		if (costHeatmap->active() != wasActive) { loadShader(); }
+	}
+	if (key == 'v') {
+		bool legacy = fullscreen().toggleLegacyQuads();
+		std::cout << "fullscreen draws: " << (legacy ? "immediate mode quads" : "vertex ID triangle") << (fullscreen().coreProfile ? " (core profile)" : "") << std::endl;
+	}
 	if (key == 'j') {
 		param1 += 0.1;
 		std::cout << "param1: " << param1 << std::endl;
@@ -274,26 +762,163 @@ void glutKeyboard(unsigned char key, int x, int y) {
 int main(int argc, char* argv[]) {
 	std::cout << "Hello, Rift!" << std::endl;
 	shader_filepath = "C:\\Users\\veliu\\Documents\\repos\\HelloCulus\\HelloCulus\\src\\shaders\\default.glsl";
-	if (argc > 1) {
-		shader_filepath = argv[1];
+	bool sweep = false;
+	bool instanceBenchmark = false;
+	bool noiseBenchmark = false;
+	bool coreProfile = false;
+	bool glDebug = false;
+	bool startCapture = false;
+	bool exportFrames = false;
+	int metricsPort = 0;
+	double readFramesSeconds = 0.0;
+	bool vulkanBenchmark = false;
+	bool vulkanCpu = false;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--sweep") { sweep = true; }
+		else if (arg == "--instance-benchmark") { instanceBenchmark = true; }
+		else if (arg == "--noise-benchmark") { noiseBenchmark = true; }
+		else if (arg == "--core") { coreProfile = true; }
+		else if (arg == "--gl-debug") { glDebug = true; }
+		else if (arg == "--mirror-hz" && i + 1 < argc) {
+			double hz = 0.0;
+			if (ShaderDirective::parseNumber(argv[++i], hz) && hz >= 0.0) { mirrorHz = hz; }
+			else { std::cout << "--mirror-hz " << argv[i] << " is not a rate in Hz, using " << mirrorHz << std::endl; }
+		}
+		else if (arg == "--capture" && i + 1 < argc) { capturePath = argv[++i]; startCapture = true; }
+		else if (arg == "--export-frames") { exportFrames = true; }
+		else if (arg == "--metrics-port" && i + 1 < argc) {
+			int port = 0;
+			if (ShaderDirective::parseNumber(argv[++i], port) && port >= 1 && port <= 65535) { metricsPort = port; }
+			else { std::cout << "--metrics-port " << argv[i] << " is not a port from 1 to 65535, no metrics" << std::endl; }
+		}
+		else if (arg == "--trace-frames" && i + 1 < argc) {
+			int frames = 0;
+			if (ShaderDirective::parseNumber(argv[++i], frames) && frames >= 1) { traceFrames = frames; }
+			else { std::cout << "--trace-frames " << argv[i] << " is not a frame count, tracing the last " << traceFrames << std::endl; }
+		}
+		else if (arg == "--read-frames") {
+			// the duration is optional, the next argument may be a shader or another option
+			readFramesSeconds = 10.0;
+			double seconds = 0.0;
+			if (i + 1 < argc && ShaderDirective::parseNumber(argv[i + 1], seconds)) {
+				i++;
+				if (seconds > 0.0) { readFramesSeconds = seconds; }
+				else { std::cout << "--read-frames " << argv[i] << " is not a positive duration, reading for " << readFramesSeconds << " s" << std::endl; }
+			}
+		}
+		else if (arg == "--vulkan-benchmark") { vulkanBenchmark = true; }
+		else if (arg == "--vulkan-cpu") { vulkanCpu = true; }
+		else { shader_filepath = arg; }
+	}
+	// Test consumer of another instance's --export-frames, needs neither a context nor the headset
+	if (readFramesSeconds > 0.0) {
+		SharedFrameReader reader;
+		return reader.run(readFramesSeconds);
+	}
+
+	profiler().nameThread("main");
+	StartupTimer startup;
+	// The runtime takes a while to start, the session is created on another thread while this one creates the
+	// context and the noise textures and compiles the shader. Swap chains need the context, they're made after.
+	struct SessionStart { ovrResult result; ovrGraphicsLuid luid; double ms; };
+	std::future<SessionStart> sessionStart;
+	if (!sweep && !instanceBenchmark && !noiseBenchmark && !vulkanBenchmark) {
+		sessionStart = std::async(std::launch::async, [] {
+			profiler().nameThread("session start");
+			ProfileZone zone("session start");
+			auto begin = std::chrono::steady_clock::now();
+			SessionStart s = {};
+			s.result = ovr_Initialize(nullptr);
+			if (OVR_SUCCESS(s.result)) {
+				s.result = ovr_Create(&session, &s.luid);
+				if (OVR_FAILURE(s.result)) { ovr_Shutdown(); }
+			}
+			s.ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+			return s;
+		});
 	}
+
 	glutInit(&argc, argv);
 	glutInitDisplayMode(GLUT_DOUBLE | GLUT_RGB);
 	glutInitWindowSize(mirrorSize.w, mirrorSize.h);
 	glutInitWindowPosition(0, 0);
+	// Everything is drawn with shaders and buffers, a core context proves no deprecated path is left
+	if (coreProfile) {
+		glutInitContextVersion(4, 5);
+		glutInitContextProfile(GLUT_CORE_PROFILE);
+	}
+	// the driver only reports everything it notices to a debug context
+	if (glDebug) { glutInitContextFlags(GLUT_DEBUG); }
 	auto win = glutCreateWindow("Points");
 
 	if (!gladLoadGL()) { std::cout << "Failed to initialize OpenGL context" << std::endl; return -1; }
+	// direct state access creates and edits objects without binding them
+	if (!GLAD_GL_VERSION_4_5) { std::cout << "OpenGL 4.5 is required, got " << glGetString(GL_VERSION) << std::endl; return -1; }
+	fullscreen().coreProfile = coreProfile;
+	std::cout << "OpenGL " << glGetString(GL_VERSION) << (coreProfile ? " (core profile)" : "") << std::endl;
+	// everything binds through it from here on
+	glState();
+	// Turn off vsync, swapping the mirror must never wait for the desktop's refresh. The WGL extension functions
+	// are only there once glad loaded them for the window's device context.
+	if (gladLoadWGL(wglGetCurrentDC()) && GLAD_WGL_EXT_swap_control) { wglSwapIntervalEXT(0); }
+	else { std::cout << "No WGL_EXT_swap_control, the mirror window swaps with vsync" << std::endl; }
+	if (glDebug) { glDebugLog().install(); }
+	startup.lap("context");
+
+	// stays bound on its own texture units for every shader
+	noise = new NoiseLibrary("HelloCulus.noise");
+	noise->bind();
+	startup.lap("noise");
+
+	// Offline quality-vs-cost exploration, doesn't need the headset
+	if (sweep) {
+		QualitySweep quality(OVR::Sizei(1344, 1600), 10);
+		quality.noise = noise;
+		return quality.run(shader_filepath);
+	}
+	if (instanceBenchmark) {
+		InstanceBenchmark benchmark(OVR::Sizei(1344, 1600), 10);
+		return benchmark.run(shader_filepath);
+	}
+	if (noiseBenchmark) {
+		NoiseBenchmark benchmark(OVR::Sizei(1344, 1600), 10, noise);
+		return benchmark.run(shader_filepath);
+	}
+	if (vulkanBenchmark) {
+#ifdef HELLOCULUS_VULKAN
+		VulkanBenchmark benchmark(OVR::Sizei(1344, 1600), 10, noise);
+		benchmark.vulkan.preferCpu = vulkanCpu;
+		return benchmark.run(shader_filepath);
+#else
+		std::cout << "Built without HELLOCULUS_VULKAN, see README" << std::endl;
+		return EXIT_FAILURE;
+#endif
+	}
 
-	ovrResult result = ovr_Initialize(nullptr);
-	if (OVR_FAILURE(result)) { std::cout << "Initialization failed with result code " << result << std::endl; return result; }
+	// Everything the main program's code depends on is known without the session. Passes of the renderers that need
+	// the eye sizes are built by the second loadShader(), which doesn't compile the main program again.
+	instanceGrid = new InstanceGrid();
+	for (int v = 0; v < 2; v++) {
+		// shaders stay attached, a reload compiles the fragment shader again and relinks
+		programs[v] = glCreateProgram();
+		fragShaderIds[v] = glCreateShader(GL_FRAGMENT_SHADER);
+		glAttachShader(programs[v], fullscreenVertexShader());
+		glAttachShader(programs[v], fragShaderIds[v]);
+		glBindFragDataLocation(programs[v], 0, "fragColor");
+	}
+	loadShader();
+	startup.lap("shader");
 
-	ovrGraphicsLuid luid;
-	result = ovr_Create(&session, &luid);
-	if (OVR_FAILURE(result)) { std::cout << "Creation failed with result code " << result << std::endl; ovr_Shutdown(); return result; }
+	SessionStart started = sessionStart.get();
+	startup.lap("waiting for session");
+	startup.overlapped("session", started.ms);
+	ovrResult result = started.result;
+	if (OVR_FAILURE(result)) { std::cout << "Session creation failed with result code " << result << std::endl; return result; }
 
 	ovrHmdDesc hmdDesc = ovr_GetHmdDesc(session);
 	printHmdInfo(hmdDesc);
+	frameRate.refreshRate = hmdDesc.DisplayRefreshRate;
 
 	// Make eye render and mirror buffers
 	for (int eye = 0; eye < 2; ++eye)
@@ -302,15 +927,49 @@ int main(int argc, char* argv[]) {
 		std::cout << "Idea Texture Size: (" << idealTextureSize.w << ", " << idealTextureSize.h << ")" << std::endl;
 		eyeRenderTexture[eye] = new OculusTextureBuffer(session, idealTextureSize, 1);
 		if (!eyeRenderTexture[eye]->ColorTextureChain || !eyeRenderTexture[eye]->DepthTextureChain) { return 0; }
+
+		ovrEyeRenderDesc renderDesc = ovr_GetRenderDesc(session, ovrEyeType(eye), hmdDesc.DefaultEyeFov[eye]);
+		hiddenAreaMask[eye] = new HiddenAreaMask(session, ovrEyeType(eye), hmdDesc.DefaultEyeFov[eye], renderDesc.HmdToEyePose.Orientation);
+		std::cout << "Hidden area: " << std::fixed << std::setprecision(1) << hiddenAreaMask[eye]->coverage() * 100.0 << "% of pixels skipped"
+			<< (hiddenAreaMask[eye]->simulated ? " (simulated mesh)" : "") << std::endl;
 	}
 	mirrorBuffer = new OculusMirrorBuffer(session, mirrorSize);
-
-	prog = glCreateProgram();
-	fragShaderId = glCreateShader(GL_FRAGMENT_SHADER);
+	mirrorBuffer->rateHz = mirrorHz;
+	if (mirrorHz <= 0.0) { mirrorBuffer->mode = MirrorMode::Off; }
+	capture = new FrameCapture(mirrorSize);
+	if (startCapture) { captureCount++; capture->start(capturePath, (int)std::lround(frameRate.refreshRate)); }
+	frameExport = new SharedFrameExport(mirrorSize);
+	if (exportFrames) { frameExport->open(); }
+	if (metricsPort > 0) {
+		metricsServer = new MetricsServer(metrics, metricsPort);
+		if (!metricsServer->start()) { delete metricsServer; metricsServer = nullptr; }
+	}
+	eyesTimer = new GpuTimer();
+	startup.lap("swap chains");
+
+	const OVR::Sizei eyeSizes[2] = { eyeRenderTexture[0]->GetSize(), eyeRenderTexture[1]->GetSize() };
+	foveation = new FoveatedRenderer(hmdDesc.DefaultEyeFov, eyeSizes);
+	temporal = new TemporalAccumulator(eyeSizes);
+	split = new SplitRenderer(eyeSizes);
+	graph = new RenderGraph(eyeSizes);
+	farField = new MonoFarField(hmdDesc.DefaultEyeFov, eyeSizes);
+	tileCuller = new TileCuller(eyeSizes);
+	costHeatmap = new CostHeatmap();
 	loadShader();
+	startup.lap("passes");
 
-	// Turn off vsync
-	// wglSwapIntervalEXT(0); // throws "Access violation executing location" exception :-( glad problem?
+	// Drivers finish some of a program's compilation on its first draw. A few pixels drawn here, into an eye buffer
+	// that is cleared again before its first commit, keep that out of the first headset frame.
+	{
+		GlDebugGroup group("warm-up");
+		eyeRenderTexture[0]->SetAndClearRenderSurface();
+		glState().viewport(0, 0, 16, 16);
+		drawScene(prog, eyeSizes[0], OVR::Vector3f(1, 0, 0), OVR::Vector3f(0, 1, 0));
+		glFinish();
+		eyeRenderTexture[0]->UnsetRenderSurface();
+	}
+	startup.lap("warm-up");
+	startup.print();
 
 	// FloorLevel will give tracking poses where the floor height is 0
 	ovr_SetTrackingOriginType(session, ovrTrackingOrigin_FloorLevel); // ovrTrackingOrigin_EyeLevel
@@ -322,14 +981,31 @@ int main(int argc, char* argv[]) {
 	glutMainLoop();
 
 	// Exit
+	std::cout << std::endl;
+	usage.print(hmdVisible ? "Rendered" : "Paused", *eyesTimer);
 	for (int eye = 0; eye < 2; ++eye) {
 		delete eyeRenderTexture[eye];
+		delete hiddenAreaMask[eye];
 	}
+	delete metricsServer;
+	delete capture;
+	delete frameExport;
 	delete mirrorBuffer;
+	delete eyesTimer;
+	delete foveation;
+	delete temporal;
+	delete split;
+	delete graph;
+	delete farField;
+	delete tileCuller;
+	delete instanceGrid;
+	delete noise;
 	ovr_Destroy(session);
 	ovr_Shutdown();
-	glDeleteProgram(prog);
-	glDeleteShader(fragShaderId);
+	for (int v = 0; v < 2; v++) {
+		glDeleteProgram(programs[v]);
+		glDeleteShader(fragShaderIds[v]);
+	}
 	std::cout << "Bye, Rift!" << std::endl;
 	return 0;
 }
\ No newline at end of file
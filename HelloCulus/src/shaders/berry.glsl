@@ -12,6 +12,29 @@ uniform float frustFovV = 1.2;
 uniform int eyeNo = 0;
 uniform float param1 = 0.0;
 
+// Quality knobs, can be overridden by the app (see HelloCulus.exe berry.glsl --sweep)
+// @sweep TRACE_STEPS 125 250 500
+// @sweep TRACE_STEP_SCALE 0.9 0.7 0.5 0.3
+// @sweep SS_SAMPLES 4 8 12 16
+// @sweep SS_STEPS 12 25 50
+// Scatter jitter comes from the noise textures, ALU_NOISE hashes it (see HelloCulus.exe berry.glsl --noise-benchmark)
+// Subsurface scattering samples are spread over 4 frames and accumulated by the app
+// @temporal 4
+// Without temporal accumulation they are evaluated at half resolution instead (see SplitRenderer.h)
+// @split 0.5
+
+#ifndef TRACE_STEPS
+#define TRACE_STEPS 250
+#endif
+#ifndef TRACE_STEP_SCALE
+#define TRACE_STEP_SCALE 0.5
+#endif
+#ifndef SS_SAMPLES
+#define SS_SAMPLES 12
+#endif
+#ifndef SS_STEPS
+#define SS_STEPS 50
+#endif
 
 float sdBerry( vec3 p, float s )
 {
@@ -57,7 +80,7 @@ float trace(inout vec3 rp, in vec3 rd, inout vec3 closestPoint)
 {
     float closest = 99.0;
     bool hit = false;
-    for (int i = 0; i < 250; ++i)
+    for (int i = 0; i < TRACE_STEPS; ++i)
     {
         float dist = map(rp);
         if (dist < closest)
@@ -71,7 +94,7 @@ float trace(inout vec3 rp, in vec3 rd, inout vec3 closestPoint)
             hit = true;
             break;
         }
-        rp += rd * max(dist * 0.5, 0.00001);
+        rp += rd * max(dist * TRACE_STEP_SCALE, 0.00001);
         
         if(rp.z > 1.0) 
         {
@@ -125,25 +148,34 @@ float ssThickness(in vec3 raypos, in vec3 lightdir, in vec3 g, in vec3 rd)
     vec3 ro = raypos;
 	
     float len = 0.0;
-    const float samples = 12.;
+    float taken = 0.0;
+    const float samples = float(SS_SAMPLES);
     const float sqs = sqrt(samples);
+    // only this frame's share of the samples, the rest comes from the history
+    int phase = temporalPhase();
     
     for (float s = -samples / 2.; s < samples / 2.; s+= 1.0)
     {
+        if (int(s + samples / 2.) % temporalPhases != phase) continue;
         vec3 rp = startFrom;
         vec3 ld = lightdir;
         
         ld.x += mod(abs(s), sqs) * ss_scatter * sign(s);
         ld.y += (s / sqs) * ss_scatter;
         
+#ifdef ALU_NOISE
         ld.x += rand(rp.xy * s) * ss_scatter;
         ld.y += rand(rp.yx * s) * ss_scatter;
         ld.z += rand(rp.zx * s) * ss_scatter;
+#else
+        // one fetch instead of three hashes, per surface point (stable over frames) and sample
+        ld += hashTex(ivec3(floor(rp * 2048.0)) + ivec3(int(s) * 17)).xyz * ss_scatter;
+#endif
 		
         ld = normalize(ld);
         vec3 dir = ld;
 		
-        for (int i = 0; i < 50; ++i)
+        for (int i = 0; i < SS_STEPS; ++i)
         {
             float dist = map(rp);
             if(dist < 0.0) dist  = min(dist, -0.0001);
@@ -153,33 +185,18 @@ float ssThickness(in vec3 raypos, in vec3 lightdir, in vec3 g, in vec3 rd)
             rp += abs(dist * 0.5) * dir;  
         }
         len += length(ro - rp);
+        taken += 1.0;
     }
     
-    return len / samples;
+    return len / max(taken, 1.0);
 }
 
 
 void main()
 {
-    vec2 res = vec2(1344, 1600);
-    vec2 q = (1.0 * gl_FragCoord.xy - 0.5 * res) / res; // [-1, 1]
-    vec3 rdFixed = normalize(vec3(q, -1));
-
-    vec3 forward = normalize(view * vec4(0, 0, -1, 1)).xyz; // local forward
-    vec3 u = normalize(cross(vec3(0, 1, 0), forward)); // local X
-    vec3 v = normalize(cross(forward, u)); // local Y
-    vec3 rd = normalize(-q.x * u + q.y * v + 1.5 * forward); // TODO: make zoom a parameter
-
-    float correction = param1;
-    vec3 roc;
-    if (eyeNo == 0)
-    {
-        roc = ro + u * correction;
-    }
-    if (eyeNo == 1)
-    {
-        roc = ro - u * correction;
-    }
+    vec2 q = (gl_FragCoord.xy - 0.5 * resolution) / resolution; // [-0.5, 0.5]
+    vec3 rd = rayDirection();
+    vec3 roc = ro;
 
     rotation = roty(sin(time * 0.5) * 2.0);
     rotation *= rotz(.8);
@@ -189,14 +206,29 @@ void main()
     //vec3 rd = normalize(vec3(p, 1.0));
     vec3 rp = roc;
 
+#if defined(PASS_EFFECT) || defined(PASS_COMPOSITE)
+    // primary hit marched by the full resolution pass: normal and outline distance
+    vec4 surface = primarySurfaceHere();
+    float hit = surface.w;
+    rp = roc + rd * primaryDistanceHere();
+    vec3 g = surface.xyz;
+#else
     // closest point is used for antialising outline of object
     vec3 closestPoint = vec3(0.0);
     float hit = trace(rp, rd, closestPoint);
-    vec4 color = vec4(.0);
     rp = closestPoint;
+    vec3 g = grad(rp);
+#endif
+#if defined(TEMPORAL) || defined(PASS_PRIMARY)
+    rayHitDistance = length(rp - roc);
+#endif
+#ifdef PASS_PRIMARY
+    fragColor = vec4(g, hit);
+    return;
+#endif
+    vec4 color = vec4(.0);
 
     vec3 ld = normalize( vec3(14.0, 1.0, 20.0) - rp);
-    vec3 g = grad(rp);
     float d = dot(g, ld);
     d = clamp(d, 0.0, 1.0);
 
@@ -210,12 +242,21 @@ void main()
     color += frn * rimCol * rimAmount * d;
 
     // subsurface        
+#ifdef PASS_COMPOSITE
+    vec4 sscol = upsampledEffect();
+#else
     float t = ssThickness(rp, ld, g, rd);
     t = exp(ss_offset -t * density);
     t = pow(t, ss_pow);
  
     vec4 sscol = t * ss_color * ss_intensity;
     sscol = mix(sscol, ss_color, 1.0 - ss_mix);
+#endif
+#ifdef PASS_EFFECT
+    fragColor = sscol;
+    return;
+#endif
+    writeRayDepth(length(rp - roc));
     color += sscol;
 	
     fragColor = vec4(.9, .9, 1.0, 1.0);
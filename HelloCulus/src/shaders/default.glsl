@@ -10,6 +10,21 @@ uniform float frustFovV = 1.2;
 uniform int eyeNo = 0;
 uniform float param1 = 0.0;
 
+// Quality knobs, can be overridden by the app (see HelloCulus.exe default.glsl --sweep)
+// @sweep MARCH_STEPS 32 64 128 256 512
+// @sweep MARCH_EPSILON 0.04 0.02 0.01 0.005 0.0025
+// The floor towards the horizon is marched once for both eyes (see FarField.h)
+// @farfield 8
+// Empty space in front of each screen tile is skipped, map() is mirrored on the CPU (see TileCulling.h, keep in sync)
+// @cull default
+
+#ifndef MARCH_STEPS
+#define MARCH_STEPS 256
+#endif
+#ifndef MARCH_EPSILON
+#define MARCH_EPSILON 0.01
+#endif
+
 float radius = 1.;
 
 float map(vec3 p)
@@ -30,50 +45,41 @@ vec3 calcNormal(vec3 p)
         e.xxx * map(p + e.xxx));
 }
 
-void main()
+float diffuse(vec3 p, vec3 normal)
 {
-    vec2 res = vec2(1344, 1600);
-    vec2 q = (1.0 * gl_FragCoord.xy - 0.5 * res) / res; // [-1, 1]
-    vec3 rdFixed = normalize(vec3(q, -1));
-
-    vec3 forward = normalize(view * vec4(0, 0, -1, 1)).xyz; // local forward
-    vec3 u = normalize(cross(vec3(0, 1, 0), forward)); // local X
-    vec3 v = normalize(cross(forward, u)); // local Y
-    vec3 rd = normalize(-q.x * u + q.y * v + 1.5 * forward); // TODO: make zoom a parameter
-
-    //float z = 0.1 / tan(frustFovV * 0.1);
-    //vec3 rd = normalize((view * vec4(q.x, q.y, -z, 1.0)).xyz);
+    vec3 light = vec3(0, 3, 0);
+    float dif = clamp(dot(normal, normalize(light - p)), 0., 1.);
+    return dif * 5. / dot(light - p, light - p);
+}
 
-    float correction = 0.5;
-    vec3 roc;
-    if (eyeNo == 0)
-    {
-        roc = ro + u * correction;
-    }
-    if (eyeNo == 1)
-    {
-        roc = ro - u * correction;
-    }
+void main()
+{
+    vec3 rd = rayDirection();
+    vec3 roc = ro;
 
-    float h, t = 1.;
-    for (int i = 0; i < 256; i++)
+    float h, t = max(max(1., marchRange.x), tileStartDistance());
+    for (int i = 0; i < MARCH_STEPS; i++)
     {
         h = map(roc + rd * t);
         t += h;
-        if (h < 0.01)
+        if (h < MARCH_EPSILON || t > marchRange.y)
             break;
     }
-    if (h < 0.01)
+    bool hit = h < MARCH_EPSILON;
+    vec3 p = roc + rd * t;
+
+    writeRayDepth(hit ? t : depthPlanes.y);
+    if (hit)
     {
-        vec3 p = roc + rd * t;
-        vec3 normal = calcNormal(p);
-        vec3 light = vec3(0, 3, 0);
-        float dif = clamp(dot(normal, normalize(light - p)), 0., 1.);
-        dif *= 5. / dot(light - p, light - p);
+        float dif = diffuse(p, calcNormal(p));
         fragColor = vec4(vec3(pow(dif, 0.4545)), 1);
     }
     else
     {
+#ifdef NEAR_FIELD
+        fragColor = farFieldColor();
+#else
         fragColor = vec4(0, 0, 0, 1);
+#endif
     }
 }
\ No newline at end of file
@@ -10,6 +10,17 @@ uniform float frustFovV = 1.2;
 uniform int eyeNo = 0;
 uniform float param1 = 0.0;
 
+// Quality knobs, can be overridden by the app (see HelloCulus.exe gyroid.glsl --sweep)
+// @sweep MARCH_STEPS 32 64 128 256 512
+// @sweep MARCH_PRECISION 0.004 0.002 0.001 0.0004 0.0001
+// Empty space in front of each screen tile is skipped, map() is mirrored on the CPU (see TileCulling.h, keep in sync)
+// @cull gyroid
+#ifndef MARCH_STEPS
+#define MARCH_STEPS 256
+#endif
+#ifndef MARCH_PRECISION
+#define MARCH_PRECISION 0.0004
+#endif
 
 #define ZERO (min(iFrame,0))
 
@@ -83,14 +94,14 @@ vec3 calcNormal( in vec3 pos )
 
 vec2 castRay( in vec3 ro, in vec3 rd )
 {
-    float tmin = 1.0;
-    float tmax = 1000.0;
+    float tmin = max(max(1.0, marchRange.x), tileStartDistance());
+    float tmax = min(1000.0, marchRange.y);
     
     float t = tmin;
     float m = -1.0;
-    for( int i=0; i<256; i++ )
+    for( int i=0; i<MARCH_STEPS; i++ )
     {
-	    float precis = 0.0004*t;
+	    float precis = MARCH_PRECISION*t;
 	    vec2 res = map( ro+rd*t );
         if( res.x<precis || t>tmax ) break;
         t += res.x;
@@ -110,6 +121,11 @@ vec3 render( in vec3 ro, in vec3 rd )
     vec2 res = castRay(ro,rd);
     float t = res.x;
 	float m = res.y;
+    writeRayDepth(m > -0.5 ? t : depthPlanes.y);
+#ifdef NEAR_FIELD
+    // nothing closer than the stereo distance
+    if( m<-0.5 ) return farFieldColor().rgb;
+#endif
     
     
     if( m>-0.5 )
@@ -159,30 +175,8 @@ mat3 setCamera( in vec3 ro, in vec3 ta, float cr )
 
 void main()
 {
-    vec2 res = vec2(1344, 1600);
-    vec2 q = (1.0 * gl_FragCoord.xy - 0.5 * res) / res; // [-1, 1]
-    vec2 p = (1.0 * gl_FragCoord.xy - 0.5 * res) / res; // [-1, 1]
-
-    vec3 rdFixed = normalize(vec3(q, -1));
-
-    vec3 forward = normalize(view * vec4(0, 0, -1, 1)).xyz; // local forward
-    vec3 u = normalize(cross(vec3(0, 1, 0), forward)); // local X
-    vec3 v = normalize(cross(forward, u)); // local Y
-    vec3 rd = normalize(-q.x * u + q.y * v + 1.5 * forward); // TODO: make zoom a parameter
-
-    //float z = 0.1 / tan(frustFovV * 0.1);
-    //vec3 rd = normalize((view * vec4(q.x, q.y, -z, 1.0)).xyz);
-
-    float correction = param1;
-    vec3 roc;
-    if (eyeNo == 0)
-    {
-        roc = ro + u * correction;
-    }
-    if (eyeNo == 1)
-    {
-        roc = ro - u * correction;
-    }
+    vec3 rd = rayDirection();
+    vec3 roc = ro;
 
     vec3 col = render(roc, rd);
     fragColor = vec4(col,1.0);
@@ -0,0 +1,84 @@
+#version 410
+out vec4 fragColor;
+
+uniform float time = 0.0;
+uniform vec3 ro = vec3(0, 0, 1.0);
+uniform mat4 view = mat4(1.0);
+uniform mat4 proj = mat4(1.0);
+uniform float frustFovH = 1.7;
+uniform float frustFovV = 1.2;
+uniform int eyeNo = 0;
+uniform float param1 = 0.0;
+
+// Field of primitives marched through a uniform grid built by the app (see InstanceGrid.h).
+// HelloCulus.exe instances.glsl --instance-benchmark times it from 100 to 100k instances
+// @instances 10000
+
+const float GROUND = -1.0;
+const vec3 SKY = vec3(0.6, 0.75, 0.9);
+
+vec3 palette(float m)
+{
+    return 0.5 + 0.5 * cos(6.2831 * (m + vec3(0.0, 0.33, 0.67)));
+}
+
+vec3 calcNormal(vec3 p)
+{
+    vec2 e = vec2(1.0, -1.0) * 0.5773 * 0.0005;
+    return normalize(
+        e.xyy * gridMap(p + e.xyy) +
+        e.yyx * gridMap(p + e.yyx) +
+        e.yxy * gridMap(p + e.yxy) +
+        e.xxx * gridMap(p + e.xxx));
+}
+
+void main()
+{
+    vec3 rd = rayDirection();
+    float tmin = max(0.2, marchRange.x);
+    float tmax = min(500.0, marchRange.y);
+    // the ground is intersected directly, instances only need to be marched up to it
+    float tGround = rd.y < 0.0 ? (GROUND - ro.y) / rd.y : 1e9;
+    tmax = min(tmax, tGround);
+
+    vec2 hit;
+#ifdef INSTANCE_BRUTE_FORCE
+    float tb = tmin;
+    float tHit = -1.0;
+    for (int i = 0; i < GRID_STEPS && tb < tmax; i++)
+    {
+        float d = instancesMap(ro + rd * tb, hit);
+        if (d < GRID_PRECISION * tb)
+        {
+            tHit = tb;
+            break;
+        }
+        tb += d;
+    }
+#else
+    float tHit = gridMarch(ro, rd, tmin, tmax, hit);
+#endif
+
+    vec3 lig = normalize(vec3(-0.5, 0.8, -0.3));
+    vec3 col = SKY - rd.y * 0.3;
+    float t = 1e9;
+    if (tHit > 0.0)
+    {
+        t = tHit;
+        vec3 p = ro + rd * t;
+        vec3 nor = calcNormal(p);
+        float dif = clamp(dot(nor, lig), 0.0, 1.0);
+        float amb = 0.5 + 0.5 * nor.y;
+        col = palette(hit.y) * (0.8 * dif + 0.3 * amb);
+    }
+    else if (tGround < min(500.0, marchRange.y))
+    {
+        t = tGround;
+        vec3 p = ro + rd * t;
+        float checker = mod(floor(p.x) + floor(p.z), 2.0);
+        col = vec3(0.35 + 0.1 * checker) * (0.3 + 0.7 * lig.y);
+    }
+    writeRayDepth(t < 1e9 ? t : depthPlanes.y);
+    col = mix(col, SKY, 1.0 - exp(-0.01 * min(t, 500.0)));
+    fragColor = vec4(pow(col, vec3(0.4545)), 1.0);
+}
@@ -0,0 +1,144 @@
+#version 410
+out vec4 fragColor;
+
+uniform float time = 0.0;
+uniform vec3 ro = vec3(0, 0, 1.0);
+uniform mat4 view = mat4(1.0);
+uniform mat4 proj = mat4(1.0);
+uniform float frustFovH = 1.7;
+uniform float frustFovV = 1.2;
+uniform int eyeNo = 0;
+uniform float param1 = 0.0;
+
+// Render graph example (see RenderGraph.h). The noise is baked once, bright parts of the scene leave glowing trails.
+// @pass Noise scale:0.25 once
+// @pass Scene in:Noise
+// @pass Bright scale:0.5 in:Scene
+// @pass Glow scale:0.5 in:Bright,Glow.prev
+// @pass Image in:Scene,Glow
+
+#ifndef MARCH_STEPS
+#define MARCH_STEPS 128
+#endif
+#ifndef MARCH_EPSILON
+#define MARCH_EPSILON 0.01
+#endif
+
+const float PERIOD = 8.0;
+
+float hash(vec2 p)
+{
+    p = mod(p, PERIOD); // tiles, so the baked texture wraps without seams
+    return fract(sin(dot(p, vec2(12.9898, 78.233))) * 43758.5453);
+}
+
+float valueNoise(vec2 p)
+{
+    vec2 i = floor(p);
+    vec2 f = fract(p);
+    f = f * f * (3.0 - 2.0 * f);
+    return mix(mix(hash(i), hash(i + vec2(1, 0)), f.x), mix(hash(i + vec2(0, 1)), hash(i + vec2(1, 1)), f.x), f.y);
+}
+
+// uv in [0, 1] tiles
+float fbm(vec2 uv)
+{
+    float v = 0.0;
+    float a = 0.5;
+    for (int i = 0; i < 4; i++)
+    {
+        v += a * valueNoise(uv * PERIOD * float(1 << i));
+        a *= 0.5;
+    }
+    return v;
+}
+
+#if defined(PASS_Noise)
+void main()
+{
+    fragColor = vec4(fbm(gl_FragCoord.xy / resolution));
+}
+
+#elif defined(PASS_Bright)
+void main()
+{
+    vec4 c = texture(iChannel0, gl_FragCoord.xy / resolution);
+    fragColor = vec4(c.rgb * c.a, 1);
+}
+
+#elif defined(PASS_Glow)
+void main()
+{
+    vec2 uv = gl_FragCoord.xy / resolution;
+    vec3 previous = texture(iChannel1, uv).rgb;
+    fragColor = vec4(mix(previous * 0.97, texture(iChannel0, uv).rgb, 0.15), 1);
+}
+
+#elif defined(PASS_Image)
+void main()
+{
+    vec2 uv = gl_FragCoord.xy / resolution;
+    vec3 c = texture(iChannel0, uv).rgb + texture(iChannel1, uv).rgb * 2.0;
+    fragColor = vec4(pow(c, vec3(0.4545)), 1);
+}
+
+#else
+// Scene pass, and the whole image when rendered without the graph: rgb color, alpha emission
+float noise(vec2 uv)
+{
+#ifdef GRAPH_PASS
+    return texture(iChannel0, fract(uv)).r;
+#else
+    return fbm(fract(uv));
+#endif
+}
+
+vec3 centers[3] = vec3[](vec3(-1, 0, -5), vec3(2, 0, -3), vec3(-2, 0, -2));
+
+float map(vec3 p)
+{
+    float d = p.y + 1.;
+    for (int i = 0; i < 3; i++)
+    {
+        d = min(d, distance(p, centers[i] + vec3(0, sin(time + float(i) * 2.0) * 0.5, 0)) - 0.6);
+    }
+    return d;
+}
+
+vec3 calcNormal(vec3 p)
+{
+    vec2 e = vec2(1.0, -1.0) * 0.0005;
+    return normalize(
+        e.xyy * map(p + e.xyy) +
+        e.yyx * map(p + e.yyx) +
+        e.yxy * map(p + e.yxy) +
+        e.xxx * map(p + e.xxx));
+}
+
+void main()
+{
+    vec3 rd = rayDirection();
+    float h, t = 1.;
+    for (int i = 0; i < MARCH_STEPS; i++)
+    {
+        h = map(ro + rd * t);
+        t += h;
+        if (h < MARCH_EPSILON)
+            break;
+    }
+    if (h >= MARCH_EPSILON)
+    {
+        fragColor = vec4(0, 0, 0, 0);
+        return;
+    }
+    vec3 p = ro + rd * t;
+    vec3 normal = calcNormal(p);
+    vec3 light = vec3(0, 3, 0);
+    float dif = clamp(dot(normal, normalize(light - p)), 0., 1.) * 5. / dot(light - p, light - p);
+    float n = noise(p.xz * 0.25 + p.y * 0.1);
+    bool ground = p.y < -0.9;
+    vec3 albedo = ground ? vec3(0.3 + 0.4 * n) : vec3(1.0, 0.5, 0.2) * (0.5 + n);
+    float emission = ground ? 0.0 : smoothstep(0.55, 0.7, n);
+    fragColor = vec4(albedo * dif + vec3(1.0, 0.6, 0.3) * emission, emission);
+}
+#endif